@@ -0,0 +1,50 @@
+#include "arena.h"
+
+#include "container.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// A few hundred containers per chunk
+static constexpr size_t chunk_size = 256 * 1024;
+
+void* arena_alloc(ContainerArena* arena, size_t size, size_t align) {
+    auto at = (char*)(((uintptr_t)arena->next + align - 1) & ~(uintptr_t)(align - 1));
+    if (!arena->next || at + size > arena->end) {
+        // Oversized requests get a chunk of their own
+        size_t size_needed = std::max(chunk_size, size + align);
+        auto*  chunk       = (char*)malloc(size_needed);
+        if (!chunk)
+            throw std::bad_alloc();
+        arena->chunks.push_back(chunk);
+        arena->next = chunk;
+        arena->end  = chunk + size_needed;
+        at          = (char*)(((uintptr_t)chunk + align - 1) & ~(uintptr_t)(align - 1));
+    }
+    arena->next = at + size;
+    arena->bytes += size;
+    return at;
+}
+
+Container* arena_container(ContainerArena* arena) {
+    if (!arena)
+        return new Container(Container::Imported{});
+    void* memory = arena_alloc(arena, sizeof(Container), alignof(Container));
+    return new (memory) Container(Container::Imported{}, arena);
+}
+
+void arena_release(ContainerArena* arena) {
+    for (auto chunk : arena->chunks)
+        free(chunk);
+    arena->chunks.clear();
+    arena->next  = nullptr;
+    arena->end   = nullptr;
+    arena->bytes = 0;
+}
+
+void discard_tree(Container* root) {
+    if (root && !root->arena)
+        delete root;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+struct Container;
+
+// Memory for the Containers of trees that are built once and dropped as a
+// whole. Containers and their child lists are bump allocated from large
+// chunks, and arena_release frees all of them at once without visiting a
+// single node.
+//
+// In the viewer an arena is only scratch space for importing a step: the
+// nodes share_tree keeps are copied to the heap, because later steps share
+// them, and the arena is released straight away. Evicting a resident step
+// goes through release_tree, which deletes the nodes no other step uses one
+// at a time.
+//
+// Containers in an arena are never deleted on their own and their destructors
+// never run, so they can't own anything: no name, user_data or callbacks. Only
+// the importers put containers in one.
+struct ContainerArena {
+    std::vector<char*> chunks;
+    char*              next = nullptr;
+    char*              end  = nullptr;
+
+    // Handed out so far
+    size_t bytes = 0;
+};
+
+void*      arena_alloc(ContainerArena* arena, size_t size, size_t align);
+
+// A container as the importers start them off, in `arena`, or on the heap
+// when `arena` is null
+Container* arena_container(ContainerArena* arena);
+
+// Frees every container and child list in the arena, which can be used again
+// afterwards
+void       arena_release(ContainerArena* arena);
+
+// Deletes a tree that isn't in an arena. Trees in one are left for
+// arena_release.
+void       discard_tree(Container* root);
+
+// Child lists of arena containers live in the arena as well; everyone else's
+// come from the heap as usual
+template <typename T>
+struct ArenaAllocator {
+    using value_type = T;
+
+    ContainerArena* arena = nullptr;
+
+    ArenaAllocator() = default;
+    ArenaAllocator(ContainerArena* arena) : arena(arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t n) {
+        if (arena)
+            return (T*)arena_alloc(arena, n * sizeof(T), alignof(T));
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* p, size_t n) {
+        if (!arena)
+            std::allocator<T>().deallocate(p, n);
+    }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const {
+        return arena == other.arena;
+    }
+};
@@ -0,0 +1,305 @@
+// containerdebug_bench_import: measures how fast each importer turns log lines
+// into Container trees, on a generated log or an existing one.
+//
+//   containerdebug_bench_import [--steps N] [--depth N] [--fanout N]
+//                               [--churn F] [--seed N] [--write out.json]
+//                               [log.json]
+//
+// The generated log has one tree of `depth` levels with `fanout` children per
+// container, written out once per step. Between steps each container changes
+// its fields with probability `churn`.
+//
+// The last row imports into an arena and then hash-conses every tree into
+// the ones kept from the steps before (share.h), the way the viewer keeps
+// steps resident, so the difference to the arena row is what sharing costs.
+
+#include "arena.h"
+#include "container.h"
+#include "import.h"
+#include "share.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+struct GenOptions {
+    int      steps  = 1000;
+    int      depth  = 5;
+    int      fanout = 4;
+    double   churn  = 0.05;
+    uint32_t seed   = 1;
+};
+
+// What the generator keeps per container between steps
+struct GenNode {
+    std::string          id;
+    int                  x = 0, y = 0, w = 0, h = 0;
+    bool                 active = false, concerned = false, exists = true;
+    bool                 hovering = false, pressing = false, dragging = false;
+    int                  button = 0;
+    int                  mouse_x = -1, mouse_y = -1;
+    int                  previous_x = -1, previous_y = -1;
+    double               spacing = 0, scroll_h = 0, scroll_v = 0;
+    std::vector<GenNode> children;
+};
+
+static void gen_change(GenNode* node, std::mt19937* rng) {
+    auto pick = [&](int n) { return (int)((*rng)() % n); };
+    node->x        = pick(1920);
+    node->y        = pick(1080);
+    node->w        = 20 + pick(400);
+    node->h        = 20 + pick(200);
+    node->active   = pick(8) == 0;
+    node->hovering = pick(4) == 0;
+    node->pressing = node->hovering && pick(2) == 0;
+    node->button   = node->pressing ? 1 + pick(3) : 0;
+    node->mouse_x  = node->hovering ? node->x + pick(node->w) : -1;
+    node->mouse_y  = node->hovering ? node->y + pick(node->h) : -1;
+    // Scroll offsets are the one place fractions show up in real logs
+    node->scroll_v = -pick(4000) / 4.0;
+}
+
+static GenNode gen_tree(const std::string& id, int depth, const GenOptions& options, std::mt19937* rng) {
+    GenNode node;
+    node.id      = id;
+    node.spacing = (*rng)() % 8;
+    gen_change(&node, rng);
+    if (depth > 1) {
+        for (int i = 0; i < options.fanout; i++)
+            node.children.push_back(gen_tree(id + "/" + std::to_string(i), depth - 1, options, rng));
+    }
+    return node;
+}
+
+static void gen_step(GenNode* node, const GenOptions& options, std::mt19937* rng) {
+    if (std::uniform_real_distribution<double>(0, 1)(*rng) < options.churn)
+        gen_change(node, rng);
+    for (auto& child : node->children)
+        gen_step(&child, options, rng);
+}
+
+// The same keys log.json has, every one of them
+static void gen_write(const GenNode& node, std::string* out) {
+    char buffer[640];
+    snprintf(buffer, sizeof(buffer),
+             "\"x\": %d, \"y\": %d, \"w\": %d, \"h\": %d, \"active\": %s, \"concerned\": %s, \"exists\": %s, "
+             "\"mouse_hovering\": %s, \"mouse_pressing\": %s, \"mouse_dragging\": %s, \"mouse_button_pressed\": %d, "
+             "\"mouse_current_x\": %d, \"mouse_current_y\": %d, \"mouse_initial_x\": %d, \"mouse_initial_y\": %d, "
+             "\"previous_x\": %d, \"previous_y\": %d, \"spacing\": %g, \"scroll_h_real\": %g, \"scroll_v_real\": %g, "
+             "\"children\": [",
+             node.x, node.y, node.w, node.h, node.active ? "true" : "false", node.concerned ? "true" : "false",
+             node.exists ? "true" : "false", node.hovering ? "true" : "false", node.pressing ? "true" : "false",
+             node.dragging ? "true" : "false", node.button, node.mouse_x, node.mouse_y, node.mouse_x, node.mouse_y,
+             node.previous_x, node.previous_y, node.spacing, node.scroll_h, node.scroll_v);
+    *out += "{\"id\": \"";
+    *out += node.id;
+    *out += "\", ";
+    *out += buffer;
+    for (size_t i = 0; i < node.children.size(); i++) {
+        if (i)
+            *out += ", ";
+        gen_write(node.children[i], out);
+    }
+    *out += "]}";
+}
+
+static std::string gen_log(const GenOptions& options) {
+    std::mt19937 rng(options.seed);
+    GenNode      root = gen_tree("root", options.depth, options, &rng);
+    std::string  log;
+    for (int step = 0; step < options.steps; step++) {
+        if (step)
+            gen_step(&root, options, &rng);
+        gen_write(root, &log);
+        log += '\n';
+    }
+    return log;
+}
+
+static bool read_file(const char* path, std::string* out) {
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return false;
+    char   buffer[1 << 16];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        out->append(buffer, read);
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+struct Line {
+    const char* begin;
+    const char* end;
+};
+
+static std::vector<Line> split_lines(const std::string& log) {
+    std::vector<Line> lines;
+    const char*       p   = log.data();
+    const char*       end = p + log.size();
+    while (p < end) {
+        auto newline = (const char*)memchr(p, '\n', end - p);
+        auto stop    = newline ? newline : end;
+        if (stop > p)
+            lines.push_back({p, stop});
+        p = stop + 1;
+    }
+    return lines;
+}
+
+static long count_nodes(const Container* c) {
+    long count = 1;
+    for (auto child : c->children)
+        count += count_nodes(child);
+    return count;
+}
+
+using Importer = Container* (*)(const char* begin, const char* end, ContainerArena* arena);
+
+static Container* import_dom(const char* begin, const char* end, ContainerArena*) {
+    return import_container(nlohmann::json::parse(begin, end));
+}
+
+// Steps the shared row keeps alive at a time
+static constexpr size_t shared_resident = 16;
+
+// Runs in its own process, so its peak RSS is its own and not what an earlier
+// importer left behind. With `use_arena`, every tree is built in an arena and
+// dropped with a single release, like the viewer does with fresh steps. With
+// `share` as well, each tree goes through share_tree first and the last
+// shared_resident of them are kept.
+static void bench(const char* name, Importer importer, bool use_arena, bool share, const std::vector<Line>& lines,
+                  size_t bytes) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return;
+    }
+    if (pid > 0) {
+        waitpid(pid, nullptr, 0);
+        return;
+    }
+
+    ContainerArena         arena;
+    SharedTrees            shared;
+    std::deque<Container*> resident;
+    long                   nodes  = 0;
+    long                   failed = 0;
+    auto                   start  = std::chrono::steady_clock::now();
+    for (const auto& line : lines) {
+        Container* root = nullptr;
+        try {
+            root = importer(line.begin, line.end, use_arena ? &arena : nullptr);
+        } catch (const nlohmann::json::exception&) {
+        }
+        if (root)
+            nodes += count_nodes(root);
+        else
+            failed++;
+        if (share && root) {
+            resident.push_back(share_tree(&shared, root));
+            if (resident.size() > shared_resident) {
+                release_tree(&shared, resident.front());
+                resident.pop_front();
+            }
+        } else {
+            discard_tree(root);
+        }
+        arena_release(&arena);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("%-10s %10.1f %14.0f %10.3f %14.1f", name, bytes / seconds / 1e6, nodes / seconds, seconds,
+           usage.ru_maxrss / 1024.0);
+    if (share)
+        printf("   %.0f%% of nodes shared", share_ratio(&shared) * 100);
+    if (failed)
+        printf("   %ld lines failed", failed);
+    printf("\n");
+    fflush(stdout);
+    _exit(0);
+}
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [--steps N] [--depth N] [--fanout N] [--churn F] [--seed N] [--write out.json] [log.json]\n",
+            program);
+}
+
+int main(int argc, char* argv[]) {
+    GenOptions  options;
+    const char* write_path = nullptr;
+    const char* read_path  = nullptr;
+    for (int arg = 1; arg < argc; arg++) {
+        std::string option = argv[arg];
+        bool        valued = option.starts_with("--") && arg + 1 < argc;
+        if (valued && option == "--steps") {
+            options.steps = atoi(argv[++arg]);
+        } else if (valued && option == "--depth") {
+            options.depth = atoi(argv[++arg]);
+        } else if (valued && option == "--fanout") {
+            options.fanout = atoi(argv[++arg]);
+        } else if (valued && option == "--churn") {
+            options.churn = atof(argv[++arg]);
+        } else if (valued && option == "--seed") {
+            options.seed = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+        } else if (valued && option == "--write") {
+            write_path = argv[++arg];
+        } else if (!option.starts_with("--") && !read_path) {
+            read_path = argv[arg];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (options.steps < 1 || options.depth < 1 || options.fanout < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::string log;
+    if (read_path) {
+        if (!read_file(read_path, &log)) {
+            fprintf(stderr, "Couldn't read %s\n", read_path);
+            return 1;
+        }
+    } else {
+        log = gen_log(options);
+    }
+    if (write_path) {
+        FILE* file = fopen(write_path, "wb");
+        bool  ok   = file && fwrite(log.data(), 1, log.size(), file) == log.size();
+        if (!file || fclose(file) != 0 || !ok) {
+            fprintf(stderr, "Couldn't write %s\n", write_path);
+            return 1;
+        }
+    }
+
+    auto lines = split_lines(log);
+    if (read_path)
+        printf("%s: %zu steps, %.1f MB\n\n", read_path, lines.size(), log.size() / 1e6);
+    else
+        printf("generated: %zu steps of depth %d, fanout %d, churn %g, %.1f MB\n\n", lines.size(), options.depth,
+               options.fanout, options.churn, log.size() / 1e6);
+
+    // Peak RSS includes the log itself, which every run holds in memory
+    printf("%-10s %10s %14s %10s %14s\n", "importer", "MB/s", "nodes/s", "time (s)", "peak RSS (MB)");
+    bench("dom", import_dom, false, false, lines, log.size());
+    bench("sax", import_container_sax, false, false, lines, log.size());
+    bench("scanned", import_container, false, false, lines, log.size());
+    bench("arena", import_container, true, false, lines, log.size());
+    bench("shared", import_container, true, true, lines, log.size());
+    return 0;
+}
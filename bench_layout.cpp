@@ -0,0 +1,250 @@
+// containerdebug_bench_layout: times building Containers and the walks the
+// viewer does over a Container tree every frame (layout, hit testing,
+// painting) on a large generated tree, and the same hit test on its flat copy
+// (flat.h). Layout is timed from scratch, with nothing changed, after a
+// change to a single leaf, and after scrolling a side panel's rows. A
+// separate chain of USE_CHILD_SIZE containers nested --nesting deep times
+// how sizing scales with depth, and a row of 100 * --fanout children twice
+// as wide as it times distributing overflow. Where the kernel lets us count
+// them, each walk also reports its last level cache misses per container.
+// check_layout.cpp checks that what is timed here lays out correctly.
+//
+//   containerdebug_bench_layout [--fanout N] [--depth N] [--nesting N] [--repeat N]
+//
+// The defaults build 111111 containers. Between building the containers,
+// unrelated allocations are made so they end up spread over the heap the way
+// they are in a long running viewer rather than packed in order.
+
+#include "container.h"
+#include "events.h"
+#include "flat.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+struct TreeOptions {
+    int fanout  = 10;
+    int depth   = 6;
+    int nesting = 50;
+    int repeat  = 20;
+};
+
+static int painted = 0;
+
+static void count_paint(Container*, Container*) {
+    painted++;
+}
+
+static Container* build_tree(int level, const TreeOptions& options, std::mt19937* rng,
+                             std::vector<std::unique_ptr<char[]>>* clutter) {
+    auto* c       = new Container(level % 2 ? layout_type::hbox : layout_type::vbox, FILL_SPACE, FILL_SPACE);
+    c->when_paint = count_paint;
+    c->spacing    = 1;
+    if (level + 1 < options.depth) {
+        for (int i = 0; i < options.fanout; i++) {
+            clutter->emplace_back(new char[64 + (*rng)() % 512]);
+            Container* child = build_tree(level + 1, options, rng, clutter);
+            child->parent    = c;
+            c->children.push_back(child);
+        }
+    }
+    return c;
+}
+
+// Each level is sized by its children: a fixed size leaf and the next level
+static Container* build_nested(Container* parent, int levels, Container** innermost) {
+    auto* c = parent->child(levels % 2 ? layout_type::hbox : layout_type::vbox, USE_CHILD_SIZE, USE_CHILD_SIZE);
+    c->child(10, 10);
+    if (levels > 1)
+        build_nested(c, levels - 1, innermost);
+    else
+        *innermost = c;
+    return c;
+}
+
+// A row of `count` children that together are twice as wide as it is
+static Container* build_overflowing_row(int count) {
+    auto* row = new Container(layout_type::hbox, count * 10 + .5, 20);
+    for (int i = 0; i < count; i++)
+        row->child(20, 20);
+    return row;
+}
+
+static long count_nodes(const Container* c) {
+    long count = 1;
+    for (auto child : c->children)
+        count += count_nodes(child);
+    return count;
+}
+
+// A counter of the cache misses this thread causes, or -1 when there is no
+// PMU to count them with (containers, most VMs)
+static int open_cache_misses() {
+#ifdef __linux__
+    perf_event_attr attr = {};
+    attr.type            = PERF_TYPE_HARDWARE;
+    attr.size            = sizeof(attr);
+    attr.config          = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled        = 1;
+    attr.exclude_kernel  = 1;
+    attr.exclude_hv      = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    return -1;
+#endif
+}
+
+static int cache_misses = -1;
+
+template <typename Fn>
+static void bench(const char* name, int repeat, long nodes, Fn fn) {
+    fn();
+#ifdef __linux__
+    if (cache_misses >= 0) {
+        ioctl(cache_misses, PERF_EVENT_IOC_RESET, 0);
+        ioctl(cache_misses, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeat; i++)
+        fn();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%-10s %12.2f %12.1f", name, seconds / repeat * 1e3, seconds / repeat / nodes * 1e9);
+    uint64_t misses = 0;
+#ifdef __linux__
+    if (cache_misses >= 0) {
+        ioctl(cache_misses, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(cache_misses, &misses, sizeof(misses)) == sizeof(misses))
+            printf(" %12.3f", (double)misses / repeat / nodes);
+    }
+#endif
+    printf("\n");
+}
+
+int main(int argc, char* argv[]) {
+    TreeOptions options;
+    for (int arg = 1; arg < argc; arg++) {
+        std::string option = argv[arg];
+        if (arg + 1 < argc && option == "--fanout") {
+            options.fanout = atoi(argv[++arg]);
+        } else if (arg + 1 < argc && option == "--depth") {
+            options.depth = atoi(argv[++arg]);
+        } else if (arg + 1 < argc && option == "--nesting") {
+            options.nesting = atoi(argv[++arg]);
+        } else if (arg + 1 < argc && option == "--repeat") {
+            options.repeat = atoi(argv[++arg]);
+        } else {
+            fprintf(stderr, "usage: %s [--fanout N] [--depth N] [--nesting N] [--repeat N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (options.fanout < 1 || options.depth < 1 || options.nesting < 1 || options.repeat < 1) {
+        fprintf(stderr, "usage: %s [--fanout N] [--depth N] [--nesting N] [--repeat N]\n", argv[0]);
+        return 2;
+    }
+
+    std::mt19937                         rng(1);
+    std::vector<std::unique_ptr<char[]>> clutter;
+    Container*                           root  = build_tree(0, options, &rng, &clutter);
+    long                                 nodes = count_nodes(root);
+    Bounds                               screen(0, 0, 1e6, 1e6);
+
+    // The hot block at the front of Container ends where the ids start
+    printf("%ld containers, sizeof(Container) %zu, hot block %td bytes, sizeof(ContainerCold) %zu\n", nodes,
+           sizeof(Container), (char*)&root->uuid - (char*)root, sizeof(ContainerCold));
+    cache_misses = open_cache_misses();
+    if (cache_misses < 0)
+        printf("no cache miss counter here, timing only\n");
+    printf("\n%-10s %12s %12s%s\n", "walk", "ms", "ns/container", cache_misses >= 0 ? "  misses/cont" : "");
+    bench("construct", options.repeat, nodes, [&] {
+        for (long i = 0; i < nodes; i++)
+            delete new Container(FILL_SPACE, FILL_SPACE);
+    });
+    // Every container gets new bounds, like when the window is resized
+    bench("layout", options.repeat, nodes, [&] {
+        screen.w = screen.w == 1e6 ? 1e6 - 100 : 1e6;
+        layout(root, root, screen);
+    });
+    Container* leaf = root;
+    while (!leaf->children.empty())
+        leaf = leaf->children.back();
+    containers_laid_out = 0;
+    bench("relayout", options.repeat, nodes, [&] { layout(root, root, screen); });
+    uint64_t relayout_visits = containers_laid_out / (options.repeat + 1);
+    containers_laid_out      = 0;
+    bench("leaf edit", options.repeat, nodes, [&] {
+        leaf->wanted_pad.x = leaf->wanted_pad.x ? 0 : 1;
+        mark_layout_dirty(leaf);
+        layout(root, root, screen);
+    });
+    uint64_t leaf_visits = containers_laid_out / (options.repeat + 1);
+    // A side panel the way main.cpp builds them: a title over 100 * --fanout
+    // rows, laid out every time through its pre_layout, and scrolled by
+    // moving the rows' children_offset_y
+    Container* window = new Container(layout_type::vbox, FILL_SPACE, FILL_SPACE);
+    Container* panel  = window->child(layout_type::vbox, FILL_SPACE, FILL_SPACE);
+    panel->pre_layout = [](Container*, Container*, const Bounds&) {};
+    panel->child(FILL_SPACE, 36);
+    Container* rows = panel->child(layout_type::vbox, FILL_SPACE, USE_CHILD_SIZE);
+    for (int i = 0; i < options.fanout * 100; i++)
+        rows->child(FILL_SPACE, 20);
+    layout(window, window, screen);
+    containers_laid_out = 0;
+    bench("scroll", options.repeat, count_nodes(window), [&] {
+        rows->children_offset_y = rows->children_offset_y ? 0 : -100;
+        layout(window, window, screen);
+    });
+    uint64_t scroll_visits = containers_laid_out / (options.repeat + 1);
+    delete window;
+
+    bench("paint", options.repeat, nodes, [&] { paint_root(root); });
+    // Every container on the path down is pierced, but every one is visited
+    bench("hit test", options.repeat, nodes, [&] { pierced_containers(root, 1, 1); });
+
+    FlatTree flat;
+    bench("flatten", options.repeat, nodes, [&] { flatten_tree(&flat, root); });
+    bench("flat hit", options.repeat, nodes, [&] { flat_pierced(&flat, 1, 1); });
+
+    // Every level is laid out again each time
+    Container* nested = new Container(FILL_SPACE, FILL_SPACE);
+    Container* innermost;
+    build_nested(nested, options.nesting, &innermost);
+    bench("nested", options.repeat, count_nodes(nested), [&] {
+        mark_layout_dirty(innermost);
+        layout(nested, nested, screen);
+    });
+    delete nested;
+
+    // Overflow is taken out in one pass, which has to leave the children
+    // where the one pixel at a time loop did
+    Container* row                       = build_overflowing_row(options.fanout * 100);
+    row->distribute_overflow_to_children = true;
+    bench("overflow", options.repeat, count_nodes(row), [&] {
+        mark_layout_dirty(row);
+        layout(row, row, screen);
+    });
+    delete row;
+
+    printf("\nlaid out per layout: %lu with nothing changed, %lu after a leaf edit, %lu after a scroll\n",
+           (unsigned long)relayout_visits, (unsigned long)leaf_visits, (unsigned long)scroll_visits);
+
+    delete root;
+#ifdef __linux__
+    if (cache_misses >= 0)
+        close(cache_misses);
+#endif
+    return painted > 0 ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+// containerdebug_check_layout: checks layout() where the incremental and
+// one pass code paths could drift from what a full layout does: overflow
+// distributed in one pass against the old one pixel at a time loop, a row
+// centred on the root following the root's size, and children that were
+// moved after their layout being skipped on the next one. Prints what went
+// wrong and exits non-zero if anything did; ctest runs it.
+//
+//   containerdebug_check_layout
+
+#include "container.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// The one pixel at a time loop layout() used to distribute overflow with,
+// run on copies of the children's bounds, to check the closed form against
+static void distribute_one_pixel_at_a_time(const Bounds& container, std::vector<Bounds>* children) {
+    double overflow = 0;
+    size_t i        = 0;
+    do {
+        auto& last  = children->back();
+        auto  right = (last.x + last.w) - container.x;
+        overflow    = right - container.w;
+        overflow--;
+        (*children)[i].w -= 1;
+        for (size_t l = i + 1; l < children->size(); l++)
+            (*children)[l].x -= 1;
+        i++;
+        if (i == children->size())
+            i = 0;
+    } while (overflow > 0);
+}
+
+static bool same_bounds(const Bounds& a, const Bounds& b) {
+    return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h;
+}
+
+// Random rows, most of them short and overflowing by less than they have
+// children, with unequal widths and at fractional x, each distributed in one
+// pass and by the old loop. Says where the first difference is.
+static bool overflow_matches_loop() {
+    std::mt19937 rng(7);
+    auto         below = [&](int n) { return (int)(rng() % n); };
+    for (int trial = 0; trial < 20000; trial++) {
+        int    count = 1 + below(trial % 4 ? 6 : 40);
+        auto*  row   = new Container(layout_type::hbox, 0, 20);
+        double total = 0;
+        for (int i = 0; i < count; i++) {
+            // child() only takes whole sizes
+            Container* child      = row->child(0, 20);
+            child->wanted_bounds.w = 1 + below(60) + below(4) * .25;
+            total += child->wanted_bounds.w;
+        }
+        double overflow      = below(3) ? below(count) + below(4) * .25 : below(200) + .5;
+        row->wanted_bounds.w = std::max(total - overflow, 1.0);
+        Bounds place(below(100) + below(8) * .125, 0, 1e6, 1e6);
+
+        layout(row, row, place);
+        std::vector<Bounds> expected;
+        for (auto child : row->children)
+            expected.push_back(child->real_bounds);
+        distribute_one_pixel_at_a_time(row->real_bounds, &expected);
+        row->distribute_overflow_to_children = true;
+        mark_layout_dirty(row);
+        layout(row, row, place);
+
+        for (size_t i = 0; i < expected.size(); i++) {
+            const Bounds& got = row->children[i]->real_bounds;
+            if (!same_bounds(got, expected[i])) {
+                printf("overflow trial %d, %d children, child %zu at x %g w %g, the old loop put it at x %g w %g\n", trial,
+                       count, i, got.x, got.w, expected[i].x, expected[i].w);
+                delete row;
+                return false;
+            }
+        }
+        delete row;
+    }
+    return true;
+}
+
+// A fixed size hbox centred on the root keeps its own bounds when only the
+// root's width changes, and must be laid out again anyway
+static bool global_centring_follows_root() {
+    Container* root = new Container(layout_type::vbox, FILL_SPACE, FILL_SPACE);
+    Container* row  = root->child(layout_type::hbox, 1000, 100);
+    row->alignment  = ALIGN_GLOBAL_CENTER_HORIZONTALLY;
+    Container* item = row->child(100, 100);
+
+    bool follows = true;
+    for (double width : {800, 600}) {
+        layout(root, root, Bounds(0, 0, width, 500));
+        follows = follows && item->real_bounds.x == width / 2 - 50;
+    }
+    delete root;
+    return follows;
+}
+
+// A row centred on the root inside a right aligned one is laid out unshifted
+// and then moved, every time. Its children, which haven't changed, are still
+// skipped after the first layout and end up in the same place.
+static bool moved_children_stay_clean() {
+    Container* root  = new Container(layout_type::vbox, FILL_SPACE, FILL_SPACE);
+    Container* outer = root->child(layout_type::hbox, FILL_SPACE, 100);
+    outer->alignment = ALIGN_RIGHT;
+    Container* row   = outer->child(layout_type::hbox, 300, 100);
+    row->alignment   = ALIGN_GLOBAL_CENTER_HORIZONTALLY;
+    for (int i = 0; i < 50; i++)
+        row->child(layout_type::hbox, 5, 5)->child(2, 2);
+
+    layout(root, root, Bounds(0, 0, 800, 600));
+    double first_x = row->children[0]->children[0]->real_bounds.x;
+    bool   clean   = true;
+    for (int i = 0; i < 3; i++) {
+        containers_laid_out = 0;
+        layout(root, root, Bounds(0, 0, 800, 600));
+        // root, outer and row, which centres on the root
+        clean = clean && containers_laid_out == 3 && row->children[0]->children[0]->real_bounds.x == first_x;
+    }
+    delete root;
+    return clean;
+}
+
+int main() {
+    bool ok = true;
+    if (!overflow_matches_loop())
+        ok = false;
+    if (!global_centring_follows_root()) {
+        printf("a globally centred row wasn't laid out again after the root was resized\n");
+        ok = false;
+    }
+    if (!moved_children_stay_clean()) {
+        printf("children moved after their layout were laid out again with nothing changed\n");
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}
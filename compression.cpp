@@ -0,0 +1,181 @@
+#include "compression.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <zlib.h>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+static bool is_gzip(const unsigned char* p, size_t size) {
+    return size >= 2 && p[0] == 0x1f && p[1] == 0x8b;
+}
+
+// Regular frames, and the skippable frames some tools keep seek tables in
+static bool is_zstd(const unsigned char* p, size_t size) {
+    if (size < 4)
+        return false;
+    uint32_t magic = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+    return magic == 0xfd2fb528 || (magic & 0xfffffff0) == 0x184d2a50;
+}
+
+log_compression compression_of(const char* data, size_t size) {
+    auto p = (const unsigned char*)data;
+    if (is_gzip(p, size))
+        return compression_gzip;
+    if (is_zstd(p, size))
+        return compression_zstd;
+    return compression_none;
+}
+
+const char* compression_name(log_compression compression) {
+    switch (compression) {
+        case compression_gzip: return ".gz";
+        case compression_zstd: return ".zst";
+        default: return "";
+    }
+}
+
+bool compression_supported(log_compression compression) {
+#ifdef HAVE_ZSTD
+    return true;
+#else
+    return compression != compression_zstd;
+#endif
+}
+
+// True if another frame follows the one that just ended; anything else
+// (padding, junk) is ignored
+static bool frame_follows(StreamDecoder* decoder) {
+    const unsigned char* p    = decoder->in + decoder->in_pos;
+    size_t               left = decoder->in_size - decoder->in_pos;
+    return decoder->compression == compression_gzip ? is_gzip(p, left) : is_zstd(p, left);
+}
+
+bool decoder_start(StreamDecoder* decoder, log_compression compression, const char* data, size_t size) {
+    decoder->compression = compression;
+    decoder->in          = (const unsigned char*)data;
+    decoder->in_size     = size;
+    decoder->in_pos      = 0;
+    decoder->frame_done  = true;
+    decoder->state       = nullptr;
+
+    if (compression == compression_gzip) {
+        auto* z = new z_stream();
+        // 16: gzip wrapper only
+        if (inflateInit2(z, 15 + 16) != Z_OK) {
+            delete z;
+            return false;
+        }
+        decoder->state = z;
+        return true;
+    }
+#ifdef HAVE_ZSTD
+    if (compression == compression_zstd) {
+        decoder->state = ZSTD_createDCtx();
+        return decoder->state != nullptr;
+    }
+#endif
+    return false;
+}
+
+static decode_status read_gzip(StreamDecoder* decoder, char* out, size_t capacity, size_t* written) {
+    auto* z = (z_stream*)decoder->state;
+    if (decoder->frame_done) {
+        inflateReset(z);
+        decoder->frame_done = false;
+    }
+    z->next_in   = (Bytef*)decoder->in + decoder->in_pos;
+    z->avail_in  = (uInt)std::min<size_t>(decoder->in_size - decoder->in_pos, UINT_MAX);
+    z->next_out  = (Bytef*)out;
+    z->avail_out = (uInt)std::min<size_t>(capacity, UINT_MAX);
+
+    uInt before     = z->avail_out;
+    int  result     = inflate(z, Z_NO_FLUSH);
+    *written        = before - z->avail_out;
+    decoder->in_pos = (const unsigned char*)z->next_in - decoder->in;
+
+    if (result == Z_STREAM_END) {
+        decoder->frame_done = true;
+        return frame_follows(decoder) ? decode_more : decode_end;
+    }
+    // Running out of input mid frame is caught by the next call
+    return result == Z_OK ? decode_more : decode_failed;
+}
+
+#ifdef HAVE_ZSTD
+static decode_status read_zstd(StreamDecoder* decoder, char* out, size_t capacity, size_t* written) {
+    auto* dctx = (ZSTD_DCtx*)decoder->state;
+    if (decoder->frame_done) {
+        ZSTD_DCtx_reset(dctx, ZSTD_reset_session_only);
+        decoder->frame_done = false;
+    }
+    ZSTD_inBuffer  in     = {decoder->in, decoder->in_size, decoder->in_pos};
+    ZSTD_outBuffer dst    = {out, capacity, 0};
+    size_t         result = ZSTD_decompressStream(dctx, &dst, &in);
+    *written              = dst.pos;
+    decoder->in_pos       = in.pos;
+
+    if (ZSTD_isError(result))
+        return decode_failed;
+    if (result == 0) {
+        decoder->frame_done = true;
+        return frame_follows(decoder) ? decode_more : decode_end;
+    }
+    // Wants more input, but there is none
+    if (in.pos == in.size && dst.pos < dst.size)
+        return decode_failed;
+    return decode_more;
+}
+#endif
+
+decode_status decoder_read(StreamDecoder* decoder, char* out, size_t capacity, size_t* written) {
+    *written = 0;
+    if (decoder->in_pos >= decoder->in_size)
+        return decoder->frame_done ? decode_end : decode_failed;
+    if (decoder->compression == compression_gzip)
+        return read_gzip(decoder, out, capacity, written);
+#ifdef HAVE_ZSTD
+    if (decoder->compression == compression_zstd)
+        return read_zstd(decoder, out, capacity, written);
+#endif
+    return decode_failed;
+}
+
+void decoder_stop(StreamDecoder* decoder) {
+    if (decoder->compression == compression_gzip && decoder->state) {
+        inflateEnd((z_stream*)decoder->state);
+        delete (z_stream*)decoder->state;
+    }
+#ifdef HAVE_ZSTD
+    if (decoder->compression == compression_zstd)
+        ZSTD_freeDCtx((ZSTD_DCtx*)decoder->state);
+#endif
+    decoder->state = nullptr;
+}
+
+bool decode_frame(log_compression compression, const char* in, size_t in_size, char* out, size_t out_size) {
+    if (compression == compression_gzip) {
+        if (in_size > UINT_MAX || out_size > UINT_MAX)
+            return false;
+        z_stream z = {};
+        if (inflateInit2(&z, 15 + 16) != Z_OK)
+            return false;
+        z.next_in   = (Bytef*)in;
+        z.avail_in  = (uInt)in_size;
+        z.next_out  = (Bytef*)out;
+        z.avail_out = (uInt)out_size;
+        bool ok     = inflate(&z, Z_FINISH) == Z_STREAM_END && z.total_out == out_size;
+        inflateEnd(&z);
+        return ok;
+    }
+#ifdef HAVE_ZSTD
+    if (compression == compression_zstd) {
+        size_t result = ZSTD_decompress(out, out_size, in, in_size);
+        return !ZSTD_isError(result) && result == out_size;
+    }
+#endif
+    return false;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Decoding of compressed logs (log.json.gz, log.json.zst). Both formats are a
+// sequence of independent frames (gzip members, zstd frames), so a log that
+// was compressed in many small frames, like bgzip or pzstd write them, can be
+// decoded a piece at a time later on.
+
+enum log_compression {
+    compression_none,
+    compression_gzip,
+    compression_zstd,
+};
+
+// Which compression `data` starts with
+log_compression compression_of(const char* data, size_t size);
+
+// Suffix for the UI, "" for none
+const char*     compression_name(log_compression compression);
+
+// False if this build can't decode `compression` (zstd is optional)
+bool            compression_supported(log_compression compression);
+
+enum decode_status {
+    decode_more,   // call again
+    decode_end,    // all input decoded
+    decode_failed, // damaged or truncated input
+};
+
+// Decodes a whole compressed log front to back
+struct StreamDecoder {
+    log_compression      compression = compression_none;
+    const unsigned char* in          = nullptr;
+    size_t               in_size     = 0;
+
+    // Input consumed so far. While frame_done is set, this is where the next
+    // frame starts.
+    size_t in_pos     = 0;
+    bool   frame_done = true;
+
+    // z_stream or ZSTD_DCtx
+    void* state = nullptr;
+};
+
+bool          decoder_start(StreamDecoder* decoder, log_compression compression, const char* data, size_t size);
+
+// Decodes up to `capacity` bytes into `out`, never past the end of a frame,
+// and sets `written` to how many it produced
+decode_status decoder_read(StreamDecoder* decoder, char* out, size_t capacity, size_t* written);
+
+void          decoder_stop(StreamDecoder* decoder);
+
+// Decodes the single frame in [in, in + in_size), which must come out as
+// exactly `out_size` bytes
+bool          decode_frame(log_compression compression, const char* in, size_t in_size, char* out, size_t out_size);
@@ -5,9 +5,9 @@
 #include <cassert>
 #include <cmath>
 #include <iostream>
+#include <new>
 
 #include <random>
-#include <sstream>
 
 #ifdef TRACY_ENABLE
 #include <tracy/Tracy.hpp>
@@ -15,8 +15,58 @@
 
 std::function<void(Container *)> on_any_container_close = nullptr;
 
-// Sum of non filler child height and spacing
+uint64_t containers_laid_out = 0;
+
+// reserved_width and reserved_height are remembered for the rest of a layout
+// pass, since a USE_CHILD_SIZE container's size is asked for by its parent,
+// by itself and by every USE_CHILD_SIZE container above it. A remembered size
+// is valid while its generation is current. The generation moves on with
+// every pass, after layout callbacks (which can change anything), when layout
+// shows or hides a child, and in mark_layout_dirty. Outside of layout() sizes
+// are never remembered.
+static uint32_t measure_generation = 1;
+static int      layout_depth       = 0;
+
+// Counts top level layout() calls, starting from 1
+static uint32_t layout_pass = 0;
+
+// Bumped whenever layout shows or hides a child. Parents measured it before
+// that, so whatever did it gets laid out again next pass.
+static uint32_t exists_changes = 0;
+
+static void set_exists(Container* c, bool exists) {
+    if (c->exists != exists) {
+        c->exists = exists;
+        measure_generation++;
+        exists_changes++;
+    }
+}
+
+static double measure_height(Container* box);
+static double measure_width(Container* box);
+
 double reserved_height(Container* box) {
+    if (!layout_depth)
+        return measure_height(box);
+    if (box->measured_h_generation != measure_generation) {
+        box->measured_h            = measure_height(box);
+        box->measured_h_generation = measure_generation;
+    }
+    return box->measured_h;
+}
+
+double reserved_width(Container* box) {
+    if (!layout_depth)
+        return measure_width(box);
+    if (box->measured_w_generation != measure_generation) {
+        box->measured_w            = measure_width(box);
+        box->measured_w_generation = measure_generation;
+    }
+    return box->measured_w;
+}
+
+// Sum of non filler child height and spacing
+static double measure_height(Container* box) {
     double space = 0;
     for (auto child : box->children) {
         if (!child->exists)
@@ -116,16 +166,29 @@ void modify_all(Container* container, double x_change, double y_change) {
 
     container->real_bounds.x += x_change;
     container->real_bounds.y += y_change;
+    container->moved_x += x_change;
+    container->moved_y += y_change;
+}
+
+Bounds screen_bounds(Container* container) {
+    Bounds bounds = container->real_bounds;
+    for (auto parent = container->parent; parent; parent = parent->parent) {
+        bounds.x += parent->children_offset_x;
+        bounds.y += parent->children_offset_y;
+    }
+    return bounds;
 }
 
 
 void layout_absolute(Container* root, Container* container, const Bounds& bounds) {
     if (container->pre_layout) {
         container->pre_layout(root, container, bounds);
+        measure_generation++;
     }
     for (auto child : container->children) {
         if (child && child->pre_layout) {
             child->pre_layout(root, child, bounds);
+            measure_generation++;
         }
     }
     for (auto child : container->children) {
@@ -135,24 +198,88 @@ void layout_absolute(Container* root, Container* container, const Bounds& bounds
     }
 }
 
+// Container::centres_on_root, worked out from the children unless it's
+// still good
+static bool centres_on_root(Container* c) {
+    bool current = c->centring_pass == layout_pass || (!c->layout_dirty && c->centring_pass != 0);
+    if (!current) {
+        bool centres = c->alignment & ALIGN_GLOBAL_CENTER_HORIZONTALLY;
+        for (auto child : c->children)
+            if (child && child->exists && centres_on_root(child))
+                centres = true;
+        c->centres_on_root = centres;
+        c->centring_pass   = layout_pass;
+    }
+    return c->centres_on_root;
+}
+
+// hbox and vbox lay out their children in two passes. Measuring works out
+// what each child is offered and how big layout() will make it; arranging
+// then lays each child out once, already where alignment wants it, instead
+// of moving whole subtrees around afterwards.
+struct Measured {
+    Container* child;
+
+    // Where the child goes before alignment, and along the box's main axis
+    // before the children ahead of it
+    Bounds offered;
+
+    // The size layout() is expected to give it
+    double w;
+    double h;
+};
+
+// Shared by nested layouts, each of which pops what it pushed
+static std::vector<Measured> measured;
+
+// Whether layout() sets a USE_CHILD_SIZE container's size from its children
+static bool sized_by_children(Container* c) {
+    if (!(c->type & (layout_type::hbox | layout_type::vbox)) || !c->should_layout_children)
+        return false;
+    if (c->type & layout_type::newscroll)
+        return !((ScrollContainer*)c)->content->children.empty();
+    return !c->children.empty();
+}
+
+// DYNAMIC sizes come from when_layout, which has already had its say in
+// what's offered, so like FILL_SPACE they take all of it
+static double laid_out_width(Container* c, double offered_w) {
+    if (c->wanted_bounds.w == FILL_SPACE || c->wanted_bounds.w == DYNAMIC)
+        return offered_w;
+    if (c->wanted_bounds.w == USE_CHILD_SIZE && sized_by_children(c))
+        return reserved_width(c);
+    return c->wanted_bounds.w;
+}
+
+static double laid_out_height(Container* c, double offered_h) {
+    if (c->wanted_bounds.h == FILL_SPACE || c->wanted_bounds.h == DYNAMIC)
+        return offered_h;
+    if (c->wanted_bounds.h == USE_CHILD_SIZE && sized_by_children(c))
+        return reserved_height(c);
+    return c->wanted_bounds.h;
+}
 
 void layout_vbox(Container* root, Container* container, const Bounds& bounds) {
     for (auto child : container->children) {
         if (child && child->pre_layout) {
             child->pre_layout(root, child, bounds);
+            measure_generation++;
         }
     }
 
     double fill_h = single_filler_height(container);
 
-    double offset = 0;
+    size_t first  = measured.size();
+    double height = 0;
     for (auto child : container->children) {
         if (child && child->exists) {
             double target_w = child->wanted_pad.x + child->wanted_pad.w;
             double target_h = child->wanted_pad.y + child->wanted_pad.h;
 
-            if (child->before_layout)
+            if (child->before_layout) {
                 child->before_layout(root, child, bounds, &target_w, &target_h);
+                measure_generation++;
+            }
 
             if (child->wanted_bounds.w == FILL_SPACE) {
                 target_w = container->children_bounds.w;
@@ -170,6 +297,7 @@ void layout_vbox(Container* root, Container* container, const Bounds& bounds) {
             }
             if (child->wanted_bounds.w == DYNAMIC || child->wanted_bounds.h == DYNAMIC) {
                 child->when_layout(root, child, bounds, &target_w, &target_h);
+                measure_generation++;
             }
 
             // Keep within horizontal bounds
@@ -224,13 +352,25 @@ void layout_vbox(Container* root, Container* container, const Bounds& bounds) {
                 }
             }
 
-            layout(root, child,
-                   Bounds(container->children_bounds.x + container->scroll_h_visual, container->children_bounds.y + offset + container->scroll_v_visual, target_w, target_h));
-
-            offset += child->real_bounds.h + container->spacing;
+            Bounds offered(container->children_bounds.x + container->scroll_h_visual, container->children_bounds.y + container->scroll_v_visual, target_w, target_h);
+            measured.push_back({child, offered, laid_out_width(child, target_w), laid_out_height(child, target_h)});
+            height += measured.back().h + container->spacing;
         }
     }
 
+    double align_offset = 0;
+    if (container->alignment & ALIGN_CENTER)
+        align_offset = bounds.h / 2 - height / 2;
+
+    double offset = 0;
+    for (size_t i = first; i < measured.size(); i++) {
+        // A copy, since laying the child out measures its own children
+        Measured m = measured[i];
+        layout(root, m.child, Bounds(m.offered.x, m.offered.y + offset + align_offset, m.offered.w, m.offered.h));
+        offset += m.child->real_bounds.h + container->spacing;
+    }
+    measured.resize(first);
+
     if (container->wanted_bounds.w == USE_CHILD_SIZE) {
         container->real_bounds.w = reserved_width(container);
     }
@@ -239,16 +379,22 @@ void layout_vbox(Container* root, Container* container, const Bounds& bounds) {
     }
 
     if (container->alignment & ALIGN_CENTER) {
-        // Get height, divide by two, subtract that by parent y - h / 2
-        double full_height  = offset;
-        double align_offset = bounds.h / 2 - full_height / 2;
-
-        modify_all(container, 0, align_offset);
+        // Get height, divide by two, subtract that by parent y - h / 2. The
+        // container moves along with its children, which are already there
+        // unless a callback resized one while it was laid out.
+        double full_height = offset;
+        double shift       = bounds.h / 2 - full_height / 2;
+        container->real_bounds.y += shift;
+        if (shift != align_offset) {
+            for (auto child : container->children)
+                if (child && child->exists)
+                    modify_all(child, 0, shift - align_offset);
+        }
     }
 }
 
 // Sum of non filler child widths and spacing
-double reserved_width(Container* box) {
+static double measure_width(Container* box) {
     double space = 0;
     for (auto child : box->children) {
         if (child) {
@@ -294,23 +440,59 @@ double single_filler_width(Container* container, const Bounds bounds) {
     return single_fill_size;
 }
 
+// How far right alignment moves the children of an hbox `w` wide that span
+// from `left` to `right`
+static double hbox_alignment_shift(Container* container, double w, double left, double right) {
+    double x                = container->real_bounds.x;
+    double total_children_w = right - left;
+    double shift            = 0;
+    if (container->alignment & ALIGN_RIGHT)
+        shift += w - container->wanted_pad.w - total_children_w;
+    if (container->alignment & ALIGN_CENTER_HORIZONTALLY) {
+        shift += (w - total_children_w) * .5;
+        // guarantee first is greater than real_bounds.x
+        if (left + shift < x)
+            shift = x - left;
+    }
+    if (container->alignment & ALIGN_GLOBAL_CENTER_HORIZONTALLY) {
+        Container* root = container;
+        while (root->parent)
+            root = root->parent;
+        shift = root->real_bounds.w / 2 - total_children_w / 2 - left;
+        // guarantee first is greater than real_bounds.x and last is less than
+        // real_bounds.x + w
+        if (left + shift < x)
+            shift = x - left;
+        if (right + shift > x + w)
+            shift = x + w - right;
+        if (left + shift < x)
+            shift = x - left;
+    }
+    return shift;
+}
+
 void layout_hbox(Container* root, Container* container, const Bounds& bounds) {
     for (auto child : container->children) {
         if (child && child->pre_layout) {
             child->pre_layout(root, child, bounds);
+            measure_generation++;
         }
     }
 
     double fill_w = single_filler_width(container, bounds);
 
-    double offset = 0;
+    size_t first  = measured.size();
+    double width  = 0;
+    double last_x = 0;
     for (auto child : container->children) {
         if (child && child->exists) {
             double target_w = child->wanted_pad.x + child->wanted_pad.w;
             double target_h = child->wanted_pad.y + child->wanted_pad.h;
 
-            if (child->before_layout)
+            if (child->before_layout) {
                 child->before_layout(root, child, bounds, &target_w, &target_h);
+                measure_generation++;
+            }
 
             if (child->wanted_bounds.w == FILL_SPACE) {
                 target_w += fill_w;
@@ -328,6 +510,7 @@ void layout_hbox(Container* root, Container* container, const Bounds& bounds) {
             }
             if (child->wanted_bounds.w == DYNAMIC || child->wanted_bounds.h == DYNAMIC) {
                 child->when_layout(root, child, bounds, &target_w, &target_h);
+                measure_generation++;
             }
 
             // Keep within horizontal bounds
@@ -382,11 +565,45 @@ void layout_hbox(Container* root, Container* container, const Bounds& bounds) {
                 }
             }
 
-            layout(root, child,
-                   Bounds(container->children_bounds.x + offset + container->scroll_h_visual, container->children_bounds.y + container->scroll_v_visual, target_w, target_h));
+            Bounds offered(container->children_bounds.x + container->scroll_h_visual, container->children_bounds.y + container->scroll_v_visual, target_w, target_h);
+            measured.push_back({child, offered, laid_out_width(child, target_w), laid_out_height(child, target_h)});
+            last_x = offered.x + width;
+            width += measured.back().w + container->spacing;
+        }
+    }
+
+    bool   aligned = first < measured.size() &&
+                   (container->alignment & (ALIGN_RIGHT | ALIGN_CENTER_HORIZONTALLY | ALIGN_GLOBAL_CENTER_HORIZONTALLY));
+    double shift   = 0;
+    if (aligned) {
+        double container_w = container->wanted_bounds.w == USE_CHILD_SIZE ? reserved_width(container) : container->real_bounds.w;
+        shift = hbox_alignment_shift(container, container_w, measured[first].offered.x, last_x + measured.back().w);
+    }
 
-            offset += child->real_bounds.w + container->spacing;
+    double offset = 0;
+    for (size_t i = first; i < measured.size(); i++) {
+        // A copy, since laying the child out measures its own children
+        Measured m = measured[i];
+        double   y = m.offered.y;
+        if ((container->alignment & ALIGN_CENTER) && m.child->wanted_bounds.h != FILL_SPACE)
+            y += bounds.h / 2 - m.h / 2;
+        // Centring on the root clamps to the container's own x, so those
+        // children are laid out where they'd be without this alignment and
+        // moved along with it afterwards, the way alignment always composed
+        if (centres_on_root(m.child)) {
+            layout(root, m.child, Bounds(m.offered.x + offset, y, m.offered.w, m.offered.h));
+            if (shift != 0)
+                modify_all(m.child, shift, 0);
+        } else {
+            layout(root, m.child, Bounds(m.offered.x + offset + shift, y, m.offered.w, m.offered.h));
         }
+
+        // Only a callback that resized the child while it was laid out puts
+        // it anywhere but where it was measured to go
+        if ((container->alignment & ALIGN_CENTER) && m.child->wanted_bounds.h != FILL_SPACE && m.child->real_bounds.h != m.h)
+            modify_all(m.child, 0, (m.h - m.child->real_bounds.h) / 2);
+        last_x = m.offered.x + offset;
+        offset += m.child->real_bounds.w + container->spacing;
     }
 
     if (container->wanted_bounds.w == USE_CHILD_SIZE) {
@@ -396,87 +613,15 @@ void layout_hbox(Container* root, Container* container, const Bounds& bounds) {
         container->real_bounds.h = reserved_height(container);
     }
 
-    if (container->alignment & ALIGN_CENTER) {
-        for (auto c : container->children) {
-            if (c->wanted_bounds.h != FILL_SPACE) {
-                // Get height, divide by two, subtract that by parent y - h / 2
-                double full_height  = c->real_bounds.h;
-                double align_offset = bounds.h / 2 - full_height / 2;
-                modify_all(c, 0, align_offset);
-            }
-        }
-    }
-    if (container->alignment & ALIGN_RIGHT) {
-        if (!container->children.empty()) {
-            Container* first            = container->children[0];
-            Container* last             = container->children[container->children.size() - 1];
-            double     total_children_w = (last->real_bounds.x + last->real_bounds.w) - first->real_bounds.x;
-
-            for (auto c : container->children) {
-                modify_all(c, (container->real_bounds.w - container->wanted_pad.w - total_children_w), 0);
-            }
-        }
-    }
-    if (container->alignment & ALIGN_CENTER_HORIZONTALLY) {
-        if (!container->children.empty()) {
-            Bounds     real_bounds      = container->real_bounds;
-            Container* first            = container->children[0];
-            Container* last             = container->children[container->children.size() - 1];
-            double     total_children_w = (last->real_bounds.x + last->real_bounds.w) - first->real_bounds.x;
-
-            for (auto c : container->children) {
-                modify_all(c, (container->real_bounds.w - total_children_w) * .5, 0);
-            }
-            // guarantee first is greater than real_bounds.x
-            if (first->real_bounds.x < real_bounds.x) {
-                auto diff = real_bounds.x - first->real_bounds.x;
-                for (auto c : container->children) {
-                    modify_all(c, diff, 0);
-                }
-            }
-        }
-    }
-    if (container->alignment & ALIGN_GLOBAL_CENTER_HORIZONTALLY) {
-        if (!container->children.empty()) {
-            Container* root = container;
-            while (true) {
-                if (root->parent == nullptr)
-                    break;
-                root = root->parent;
-            }
-
-            Bounds     real_bounds      = container->real_bounds;
-            Container* first            = container->children[0];
-            Container* last             = container->children[container->children.size() - 1];
-            double     total_children_w = (last->real_bounds.x + last->real_bounds.w) - first->real_bounds.x;
-            double     target_x         = root->real_bounds.w / 2 - total_children_w / 2;
-            double     initial_x        = first->real_bounds.x;
-            for (auto c : container->children) {
-                modify_all(c, target_x - initial_x, 0);
-            }
-            // guarantee first is greater than real_bounds.x
-            if (first->real_bounds.x < real_bounds.x) {
-                auto diff = real_bounds.x - first->real_bounds.x;
-                for (auto c : container->children) {
-                    modify_all(c, diff, 0);
-                }
-            }
-            // guarantee last is less than real_bounds.x
-            if (last->real_bounds.x + last->real_bounds.w > real_bounds.x + real_bounds.w) {
-                auto diff = (real_bounds.x + real_bounds.w) - (last->real_bounds.x + last->real_bounds.w);
-                for (auto c : container->children) {
-                    modify_all(c, diff, 0);
-                }
-            }
-            // guarantee first is greater than real_bounds.x
-            if (first->real_bounds.x < real_bounds.x) {
-                auto diff = real_bounds.x - first->real_bounds.x;
-                for (auto c : container->children) {
-                    modify_all(c, diff, 0);
-                }
-            }
+    if (aligned) {
+        double actual = hbox_alignment_shift(container, container->real_bounds.w, measured[first].offered.x,
+                                             last_x + measured.back().child->real_bounds.w);
+        if (actual != shift) {
+            for (size_t i = first; i < measured.size(); i++)
+                modify_all(measured[i].child, actual - shift, 0);
         }
     }
+    measured.resize(first);
 }
 
 void layout_stack(Container* root, Container* container, const Bounds& bounds) {
@@ -566,8 +711,8 @@ void layout_scrollpane(Container* root, Container* container, const Bounds& boun
             }
         }
     }
-    r_bar->exists = (r_w != 0);
-    b_bar->exists = (b_h != 0);
+    set_exists(r_bar, r_w != 0);
+    set_exists(b_bar, b_h != 0);
 
     if (!(options & ::scrollpane_inline_r) && !(options & ::scrollpane_inline_b)) {
         layout(root, content_area, Bounds(bounds.x, bounds.y, bounds.w - r_w, bounds.h - b_h));
@@ -673,12 +818,49 @@ void layout_newscrollpane(Container* root, ScrollContainer* scroll, const Bounds
     }
 }
 
-void layout(Container* root, Container* container, const Bounds& bounds) {
+// Takes one pixel at a time off the children, first to last and around
+// again, until the last one ends inside the container, shifting the ones
+// after each shrunk child back with it. At least one pixel is always taken.
+// Every pixel pulls the last child's right edge in by one, so how many are
+// taken follows from the overflow up front, and each child's share and how
+// far it moves back from that.
+static void distribute_overflow(Container* container) {
+    auto&  children = container->children;
+    size_t count    = children.size();
+    auto   last     = children[count - 1];
+    double edge     = last->real_bounds.x + last->real_bounds.w;
+
+    // Overflow left once pixel k (from 0) is taken, worked out the way the
+    // one pixel at a time loop did. The last pixel is the first k where
+    // nothing is left.
+    auto left_after = [&](uint64_t k) {
+        return edge - (double)k - container->real_bounds.x - container->real_bounds.w - 1;
+    };
+    uint64_t last_pixel = 0;
+    if (left_after(0) > 0)
+        last_pixel = (uint64_t)std::ceil(left_after(0));
+    // Rounding can put the estimate one off
+    if (last_pixel > 0 && left_after(last_pixel - 1) <= 0)
+        last_pixel--;
+    else if (left_after(last_pixel) > 0)
+        last_pixel++;
+    uint64_t pixels = last_pixel + 1;
+
+    uint64_t shift = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t share = pixels / count + (i < pixels % count ? 1 : 0);
+        children[i]->real_bounds.x -= (double)shift;
+        children[i]->real_bounds.w -= (double)share;
+        shift += share;
+    }
+}
+
+static void layout_container(Container* root, Container* container, const Bounds& bounds) {
     container->real_bounds.x = bounds.x;
     container->real_bounds.y = bounds.y;
 
-    bool fill_w              = container->wanted_bounds.w == FILL_SPACE;
-    bool fill_h              = container->wanted_bounds.h == FILL_SPACE;
+    bool fill_w              = container->wanted_bounds.w == FILL_SPACE || container->wanted_bounds.w == DYNAMIC;
+    bool fill_h              = container->wanted_bounds.h == FILL_SPACE || container->wanted_bounds.h == DYNAMIC;
     container->real_bounds.w = (fill_w) ? bounds.w : container->wanted_bounds.w;
     container->real_bounds.h = (fill_h) ? bounds.h : container->wanted_bounds.h;
 
@@ -716,10 +898,10 @@ void layout(Container* root, Container* container, const Bounds& bounds) {
         for (int i = 0; i < container->children.size(); i++) {
             auto child = container->children[i];
             if (i == 0) {
-                child->exists = true;
+                set_exists(child, true);
                 layout(root, child, bounds);
             } else {
-                child->exists = false;
+                set_exists(child, false);
             }
         }
     } else if (container->type & layout_type::newscroll) {
@@ -745,24 +927,8 @@ void layout(Container* root, Container* container, const Bounds& bounds) {
         }
     }
 
-    if (container->distribute_overflow_to_children) {
-        if (!container->children.empty()) {
-            double overflow = 0;
-            int    i        = 0;
-            do {
-                auto last  = container->children[container->children.size() - 1];
-                auto right = (last->real_bounds.x + last->real_bounds.w) - container->real_bounds.x;
-                overflow   = right - container->real_bounds.w;
-                overflow--;
-                container->children[i]->real_bounds.w -= 1;
-                for (int l = i + 1; l < container->children.size(); l++)
-                    container->children[l]->real_bounds.x -= 1;
-                i++;
-                if (i == container->children.size())
-                    i = 0;
-            } while (overflow > 0);
-        }
-    }
+    if (container->distribute_overflow_to_children && !container->children.empty())
+        distribute_overflow(container);
 
     //    if (generate_event) {
     //        if (container->when_layout) {
@@ -771,12 +937,72 @@ void layout(Container* root, Container* container, const Bounds& bounds) {
     //    }
 }
 
+static bool same_bounds(const Bounds& a, const Bounds& b) {
+    return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h;
+}
+
+// Callbacks can change anything, so containers with them are laid out every
+// time, and so are scroll containers, whose parts aren't in `children`, and
+// globally centred ones, which read the root's width rather than their bounds
+static bool always_layout(Container* container) {
+    return container->pre_layout || container->before_layout || container->when_layout ||
+           (container->type & layout_type::newscroll) || (container->alignment & ALIGN_GLOBAL_CENTER_HORIZONTALLY);
+}
+
+void layout(Container* root, Container* container, const Bounds& bounds) {
+    // Same result as last time. The parent rounds, shrinks or moves our
+    // bounds once we return, so they are put back the way layout left them,
+    // and whatever moved the children since is taken back for it to do again.
+    if (!container->layout_dirty && same_bounds(container->layout_bounds, bounds)) {
+        if (container->moved_x != 0 || container->moved_y != 0) {
+            for (auto child : container->children)
+                if (child)
+                    modify_all(child, -container->moved_x, -container->moved_y);
+            container->moved_x = 0;
+            container->moved_y = 0;
+        }
+        container->real_bounds     = container->layout_real_bounds;
+        container->children_bounds = container->layout_children_bounds;
+        return;
+    }
+
+    containers_laid_out++;
+    if (!layout_depth++) {
+        measure_generation++;
+        layout_pass++;
+    }
+    uint32_t changes_before = exists_changes;
+    layout_container(root, container, bounds);
+    layout_depth--;
+
+    bool dirty = always_layout(container) || exists_changes != changes_before;
+    for (auto child : container->children)
+        if (child && child->exists && child->layout_dirty)
+            dirty = true;
+    container->layout_dirty           = dirty;
+    container->centring_pass          = 0;
+    centres_on_root(container);
+    container->layout_bounds          = bounds;
+    container->layout_real_bounds     = container->real_bounds;
+    container->layout_children_bounds = container->children_bounds;
+    container->moved_x                = 0;
+    container->moved_y                = 0;
+}
+
+void mark_layout_dirty(Container* container) {
+    measure_generation++;
+    for (; container; container = container->parent) {
+        container->layout_dirty  = true;
+        container->centring_pass = 0;
+    }
+}
+
 Container* container_by_name(std::string name, Container* root) {
     if (!root) {
         return nullptr;
     }
 
-    if (root->name == name) {
+    if (root->cold->name == name) {
         return root;
     }
 
@@ -811,7 +1037,7 @@ Container* container_by_name_up(std::string name, Container* root) {
     auto parent = root->parent;
     if (!parent)
         return nullptr;
-    if (parent->name == name) {
+    if (parent->cold->name == name) {
         return parent;
     }
 
@@ -955,36 +1181,50 @@ Bounds Bounds::round() {
     return *this;
 }
 
-std::string get_uuid() {
-    std::random_device              rd;
-    std::mt19937                    gen(rd());
-    std::uniform_int_distribution<> dis(0, 15);
-    std::uniform_int_distribution<> dis2(8, 11); // for variant
-
-    std::stringstream               ss;
-    ss << std::hex;
-    for (int i = 0; i < 8; i++)
-        ss << dis(gen);
-    ss << "-";
-    for (int i = 0; i < 4; i++)
-        ss << dis(gen);
-    ss << "-4"; // UUID version 4
-    for (int i = 0; i < 3; i++)
-        ss << dis(gen);
-    ss << "-";
-    ss << dis2(gen); // UUID variant
-    for (int i = 0; i < 3; i++)
-        ss << dis(gen);
-    ss << "-";
-    for (int i = 0; i < 12; i++)
-        ss << dis(gen);
-    return ss.str();
+// splitmix64
+static uint64_t next_random(uint64_t* state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+    z          = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z          = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static uint64_t seed_random() {
+    std::random_device rd;
+    return (uint64_t)rd() << 32 | rd();
+}
+
+Uuid get_uuid() {
+    thread_local uint64_t state = seed_random();
+
+    Uuid uuid;
+    uuid.hi = next_random(&state);
+    uuid.lo = next_random(&state);
+    // Version 4, variant 10xx
+    uuid.hi = (uuid.hi & ~0xf000ull) | 0x4000ull;
+    uuid.lo = (uuid.lo & ~(3ull << 62)) | (2ull << 62);
+    return uuid;
+}
+
+std::string Uuid::str() const {
+    static const char digits[] = "0123456789abcdef";
+
+    std::string text(36, '-');
+    int         at = 0;
+    for (int i = 0; i < 32; i++) {
+        if (i == 8 || i == 12 || i == 16 || i == 20)
+            at++;
+        uint64_t half = i < 16 ? hi : lo;
+        text[at++]    = digits[(half >> (60 - 4 * (i % 16))) & 0xf];
+    }
+    return text;
 }
 
 Container* Container::child(int wanted_width, int wanted_height) {
     Container* child_container = new Container(wanted_width, wanted_height);
     child_container->parent    = this;
     this->children.push_back(child_container);
+    mark_layout_dirty(this);
     return child_container;
 }
 
@@ -993,26 +1233,79 @@ Container* Container::child(int type, int wanted_width, int wanted_height) {
     child_container->type      = type;
     child_container->parent    = this;
     this->children.push_back(child_container);
+    mark_layout_dirty(this);
     return child_container;
 }
 
+struct HandleTable {
+    struct Slot {
+        Container* container  = nullptr;
+        uint32_t   generation = 1;
+    };
+
+    // Slot 0 is never handed out, so a zeroed handle is never alive
+    std::vector<Slot>     slots = {Slot{}};
+    std::vector<uint32_t> free_slots;
+};
+
+static HandleTable& handle_table() {
+    static HandleTable table;
+    return table;
+}
+
+static ContainerHandle acquire_handle(Container* c) {
+    auto&    t = handle_table();
+    uint32_t slot;
+    if (!t.free_slots.empty()) {
+        slot = t.free_slots.back();
+        t.free_slots.pop_back();
+    } else {
+        slot = (uint32_t)t.slots.size();
+        t.slots.emplace_back();
+    }
+    t.slots[slot].container = c;
+    return {slot, t.slots[slot].generation};
+}
+
+static void release_handle(ContainerHandle handle) {
+    if (!handle.slot)
+        return;
+    auto& t                        = handle_table();
+    t.slots[handle.slot].container = nullptr;
+    t.slots[handle.slot].generation++;
+    t.free_slots.push_back(handle.slot);
+}
+
+bool container_alive(ContainerHandle handle) {
+    auto& t = handle_table();
+    return handle.slot && handle.slot < t.slots.size() && t.slots[handle.slot].generation == handle.generation;
+}
+
+Container* container_from_handle(ContainerHandle handle) {
+    return container_alive(handle) ? handle_table().slots[handle.slot].container : nullptr;
+}
+
 Container::Container(layout_type type, double wanted_width, double wanted_height) {
     this->type      = type;
     wanted_bounds.w = wanted_width;
     wanted_bounds.h = wanted_height;
     uuid            = get_uuid();
+    handle          = acquire_handle(this);
 }
 
 Container::Container(double wanted_width, double wanted_height) {
     wanted_bounds.w = wanted_width;
     wanted_bounds.h = wanted_height;
     uuid            = get_uuid();
+    handle          = acquire_handle(this);
 }
 
 Container::Container(const Container& c) {
-    parent = c.parent;
-    name   = c.name;
-    uuid   = c.uuid;
+    handle     = acquire_handle(this);
+    parent     = c.parent;
+    cold->name = c.cold->name;
+    uuid       = c.uuid;
+    uuid_id = c.uuid_id;
 
     for (auto child : c.children) {
         children.push_back(new Container(*child));
@@ -1027,26 +1320,30 @@ Container::Container(const Container& c) {
     real_bounds     = c.real_bounds;
     children_bounds = c.children_bounds;
     interactable    = c.interactable;
+
+    children_offset_x = c.children_offset_x;
+    children_offset_y = c.children_offset_y;
     alignment       = c.alignment;
 
     should_layout_children = c.should_layout_children;
     clip_children          = c.clip_children;
 
-    when_paint                      = c.when_paint;
-    when_layout                     = c.when_layout;
-    when_mouse_enters_container     = c.when_mouse_enters_container;
-    when_mouse_leaves_container     = c.when_mouse_leaves_container;
-    when_scrolled                   = c.when_scrolled;
-    when_drag_start                 = c.when_drag_start;
-    when_drag                       = c.when_drag;
-    when_drag_end                   = c.when_drag_end;
-    when_mouse_down                 = c.when_mouse_down;
-    when_mouse_up                   = c.when_mouse_up;
-    when_clicked                    = c.when_clicked;
-    distribute_overflow_to_children = c.distribute_overflow_to_children;
+    when_paint                            = c.when_paint;
+    when_layout                           = c.when_layout;
+    cold->when_mouse_enters_container     = c.cold->when_mouse_enters_container;
+    cold->when_mouse_leaves_container     = c.cold->when_mouse_leaves_container;
+    cold->when_scrolled                   = c.cold->when_scrolled;
+    cold->when_drag_start                 = c.cold->when_drag_start;
+    cold->when_drag                       = c.cold->when_drag;
+    cold->when_drag_end                   = c.cold->when_drag_end;
+    cold->when_mouse_down                 = c.cold->when_mouse_down;
+    cold->when_mouse_up                   = c.cold->when_mouse_up;
+    cold->when_clicked                    = c.cold->when_clicked;
+    distribute_overflow_to_children       = c.distribute_overflow_to_children;
 }
 
 Container::~Container() {
+    release_handle(handle);
     for (auto child : children) {
         if (child->type == layout_type::newscroll) {
             delete (ScrollContainer*)child;
@@ -1054,21 +1351,32 @@ Container::~Container() {
             delete child;
         }
     }
-    if (this->on_closed)
-       this->on_closed(this);
+    if (cold->on_closed)
+       cold->on_closed(this);
     if (on_any_container_close) {
         on_any_container_close(this);
     }
     //    auto data = static_cast<UserData *>(user_data);
-    if (skip_delete)
-        return;
-    auto data = (UserData*)user_data;
-    if (data != nullptr) {
-        data->destroy();
+    if (!skip_delete) {
+        auto data = (UserData*)cold->user_data;
+        if (data != nullptr) {
+            data->destroy();
+        }
     }
 
     // clear_data_for(this);
     //    ((UserData *) user_data)->destroy();
+    if (!arena)
+        delete cold;
+}
+
+Container::Container(Imported) {
+    type = layout_type::hbox;
+}
+
+Container::Container(Imported, ContainerArena* arena)
+    : children(arena), arena(arena), cold(new (arena_alloc(arena, sizeof(ContainerCold), alignof(ContainerCold))) ContainerCold) {
+    type = layout_type::hbox;
 }
 
 Container::Container() {
@@ -1077,8 +1385,8 @@ Container::Container() {
     z_index                = 0;
     spacing                = 0;
     should_layout_children = true;
-    user_data              = nullptr;
     uuid                   = get_uuid();
+    handle                 = acquire_handle(this);
 }
 
 ScrollContainer* Container::scrollchild(const ScrollPaneSettings& scroll_pane_settings) {
@@ -5,6 +5,8 @@
 #include <string>
 #include <vector>
 
+#include "arena.h"
+
 #define explicit dont_use_cxx_explicit
 #include <xcb/xcb_keysyms.h>
 #include <xcb/xkb.h>
@@ -187,45 +189,50 @@ struct MouseState {
     }
 };
 
-struct ScrollContainer;
-struct ScrollPaneSettings;
+// A random (version 4) UUID, kept as its 128 bits. Text is only made for it
+// when something asks.
+struct Uuid {
+    uint64_t hi = 0;
+    uint64_t lo = 0;
 
-struct Container {
-    // The parent of this container which must be set by the user whenever a
-    // relationship is added
-    Container* parent = nullptr;
+    bool operator==(const Uuid& other) const = default;
 
-    // A user settable name that can be used for retrival
-    std::string name;
-
-    int custom_type = 0;
-
-    // List of this containers children;
-    std::vector<Container*> children;
-
-    // The way children are laid out
-    int type = vbox;
+    // xxxxxxxx-xxxx-4xxx-yxxx-xxxxxxxxxxxx
+    std::string str() const;
+};
 
-    // Unique id for this container
-    std::string uuid;
+// A new random Uuid. Draws from a generator each thread seeds once, so there
+// is no allocation or system call per id.
+Uuid get_uuid();
+
+// Refers to a Container without keeping it alive, for code that calls out to
+// a callback and needs to know afterwards whether the container was deleted
+// meanwhile. Every UI container owns a slot in one table; deleting the
+// container bumps the slot's generation, so checking a handle is a plain
+// integer compare.
+//
+// The table belongs to the thread that builds the UI. Imported containers
+// don't get a slot, and their handles never count as alive.
+struct ContainerHandle {
+    uint32_t slot       = 0;
+    uint32_t generation = 0;
+};
 
-    // A higher z_index will mean it will be rendered above everything else
-    int z_index = 0;
+bool       container_alive(ContainerHandle handle);
 
-    // Spacing between children when laying them out
-    double spacing = 0;
+// The container `handle` refers to, or nullptr once it is deleted
+Container* container_from_handle(ContainerHandle handle);
 
-    // Where you are placed inside the parent
-    int alignment = 0;
+struct ScrollContainer;
+struct ScrollPaneSettings;
 
-    // These numbers are usually going to be negative
-    // The underlying real scrolling offset along an axis
-    double                scroll_v_real = 0;
-    double                scroll_h_real = 0;
+// The part of a Container the frame walks never read, kept apart so that
+// walking a tree doesn't drag it through the cache. See Container::cold.
+struct ContainerCold {
+    // A user settable name that can be used for retrival
+    std::string name;
 
-    std::shared_ptr<bool> lifetime        = std::make_shared<bool>();
-    double                scroll_v_visual = 0;
-    double                scroll_h_visual = 0;
+    int custom_type = 0;
 
     bool                  consumed_event  = false;
     bool                  left_mouse_down = false;
@@ -236,52 +243,10 @@ struct Container {
     int                   mouse_initial_x = -1;
     int                   mouse_initial_y = -1;
 
-    bool first_paint = true;
-
     bool                  include_children_outside_parent_bounds = false; // for interaction purposes that is (fill_list_with_pierced)
 
-    // State of the mouse used by application.cpp to determine when to call this
-    // containers when_* functions
-    MouseState state;
-
-    // User settable target bounds
-    Bounds wanted_bounds;
-
-    // User settable target padding for children of this container
-    Bounds wanted_pad;
-
-    // real_bounds is generated after calling layout on the root container and is
-    // the bounds of this container
-    Bounds real_bounds;
-
-    // children_bounds is generated after calling layout on the root container and
-    // is the bounds of the children since remember you can set a wanted_pad
-    // amount
-    Bounds children_bounds;
-
-    // This variable can be set by layout parent to determine if it should be
-    // rendered
-    bool exists = true;
-
-    // Variable meaning if we should layout the children whenever layout is called
-    // on this container
-    bool should_layout_children = true;
-
-    // This doesn't actually do clipping on children to the parent containers
-    // bounds when rendering, instead it tells us if we should call the render
-    // function of non visible children containers
-    bool clip_children = true;
-
-    bool clip = false;
-
-    bool interactable = true;
-
     bool draggable = true;
 
-    // If set to true, after layout of children, will check if there was overflow,
-    // if so, will distribute one pixel at a time
-    bool distribute_overflow_to_children = false;
-
     // Is set to true when the container is the active last interacted with
     bool active = false;
 
@@ -300,20 +265,10 @@ struct Container {
     // (children)
     bool receive_events_even_if_obstructed = false;
 
-    // Do children get painted
-    bool  automatically_paint_children = true;
-
     void* user_data = nullptr;
     
     // Called when client needs to repaint itself
     void (*on_closed)(Container* self) = nullptr;
-
-    // Called when client needs to repaint itself
-    void (*when_paint)(Container* root, Container* self) = nullptr;
-
-    // Called after all children painted
-    void (*after_paint)(Container* root, Container* self) = nullptr;
-
     // Called once when the mouse enters the container for the first time
     void (*when_mouse_enters_container)(Container* root, Container* self) = nullptr;
 
@@ -358,6 +313,135 @@ struct Container {
     // Called once when after dragging a container the mouse_up happens
     void (*when_drag_end)(Container* root, Container* self) = nullptr;
 
+    void (*when_key_event)(Container* root, Container* self, bool is_string, xkb_keysym_t keysym, char string[64], uint16_t mods, xkb_key_direction direction) = nullptr;
+};
+
+struct Container {
+    // Layout, hit testing and painting walk every container each frame but only
+    // read the fields in this first block, so they are kept together at the
+    // front: a walk touches the first few cache lines of each container instead
+    // of all of them. Below the block are the ids, and everything else lives
+    // in a ContainerCold of its own (see `cold`).
+
+    // List of this containers children. Adding them with child() marks the
+    // container for layout; anything else that changes the list has to call
+    // mark_layout_dirty itself.
+    std::vector<Container*, ArenaAllocator<Container*>> children;
+
+    // The parent of this container which must be set by the user whenever a
+    // relationship is added
+    Container* parent = nullptr;
+
+    // The way children are laid out (mark_layout_dirty after changing it)
+    int type = vbox;
+
+    // Where you are placed inside the parent (mark_layout_dirty after
+    // changing it)
+    int alignment = 0;
+
+    // A higher z_index will mean it will be rendered above everything else
+    int z_index = 0;
+
+    // State of the mouse used by application.cpp to determine when to call this
+    // containers when_* functions
+    MouseState state;
+
+    // This variable can be set by layout parent to determine if it should be
+    // rendered. Anyone else setting it calls mark_layout_dirty on the parent.
+    bool exists = true;
+
+    // Variable meaning if we should layout the children whenever layout is called
+    // on this container (mark_layout_dirty after changing it)
+    bool should_layout_children = true;
+
+    // This doesn't actually do clipping on children to the parent containers
+    // bounds when rendering, instead it tells us if we should call the render
+    // function of non visible children containers
+    bool clip_children = true;
+
+    bool clip = false;
+
+    bool interactable = true;
+
+    // Do children get painted
+    bool  automatically_paint_children = true;
+
+    // If set to true, after layout of children, will check if there was overflow,
+    // if so, will distribute one pixel at a time. Takes effect at the next
+    // layout after mark_layout_dirty.
+    bool distribute_overflow_to_children = false;
+
+    bool first_paint = true;
+
+    // Set while something layout() reads may have changed since this container
+    // was last laid out, here or further down, and always for containers with
+    // layout callbacks. Clean containers given the same bounds as last time
+    // are skipped. See mark_layout_dirty: every field layout() reads says
+    // when it needs calling, and a layout callback changing containers other
+    // than its own has to call it for them as well.
+    bool layout_dirty = true;
+
+    // Whether this container or one under it centres on the root
+    // (ALIGN_GLOBAL_CENTER_HORIZONTALLY), which makes where its children go
+    // depend on more than its own x. Worked out again once per layout pass
+    // while the container is dirty, and by layout() itself; 0 for never.
+    bool     centres_on_root = false;
+    uint32_t centring_pass   = 0;
+
+    // Spacing between children when laying them out. Call mark_layout_dirty
+    // after changing it.
+    double spacing = 0;
+
+    // These numbers are usually going to be negative
+    // The underlying real scrolling offset along an axis. Layout of a vbox or
+    // hbox offsets the children by the visual ones, so changing those needs
+    // mark_layout_dirty, and children_offset is the cheaper way to scroll.
+    double                scroll_v_real = 0;
+    double                scroll_h_real = 0;
+    double                scroll_v_visual = 0;
+    double                scroll_h_visual = 0;
+
+    // Where the children are painted and hit tested relative to where layout
+    // put them. Their real_bounds are left alone, so scrolling a long list
+    // this way is one assignment however many rows it has. Hit testing
+    // applies it on the way down; whoever paints the container has to apply
+    // it to what the children draw (main.cpp does it with a 2D camera).
+    double children_offset_x = 0;
+    double children_offset_y = 0;
+
+    // User settable target bounds (mark_layout_dirty after changing them)
+    Bounds wanted_bounds;
+
+    // User settable target padding for children of this container
+    // (mark_layout_dirty after changing it)
+    Bounds wanted_pad;
+
+    // real_bounds is generated after calling layout on the root container and is
+    // the bounds of this container
+    Bounds real_bounds;
+
+    // children_bounds is generated after calling layout on the root container and
+    // is the bounds of the children since remember you can set a wanted_pad
+    // amount
+    Bounds children_bounds;
+
+    // What the last layout() of this container was given and produced, so a
+    // clean one can be skipped by putting its own bounds back. How far
+    // modify_all moved it since is kept in moved_x and moved_y, and a skipped
+    // container takes that back off its children before its parent moves
+    // them again.
+    Bounds layout_bounds;
+    Bounds layout_real_bounds;
+    Bounds layout_children_bounds;
+    double moved_x = 0;
+    double moved_y = 0;
+
+    // reserved_width and reserved_height remembered during a layout pass
+    double   measured_w            = 0;
+    double   measured_h            = 0;
+    uint32_t measured_w_generation = 0;
+    uint32_t measured_h_generation = 0;
+
     // If this function is set, it'll be called to determine if the container is
     // pierced
     bool (*handles_pierced)(Container* container, int mouse_x, int mouse_y) = nullptr;
@@ -371,7 +455,32 @@ struct Container {
     // call
     void (*when_layout)(Container* root, Container* self, const Bounds& bounds, double* target_w, double* target_h) = nullptr;
 
-    void (*when_key_event)(Container* root, Container* self, bool is_string, xkb_keysym_t keysym, char string[64], uint16_t mods, xkb_key_direction direction) = nullptr;
+    // Called when client needs to repaint itself
+    void (*when_paint)(Container* root, Container* self) = nullptr;
+
+    // Called after all children painted
+    void (*after_paint)(Container* root, Container* self) = nullptr;
+
+    // End of the hot block
+
+    // Unique id for this container
+    Uuid uuid;
+
+    // Containers imported from a log leave uuid zero and name empty and keep
+    // their uuid as an intern.h id here instead
+    uint32_t uuid_id = 0;
+
+    // Set for containers that live in an arena (arena.h), which are never
+    // deleted on their own
+    ContainerArena* arena = nullptr;
+
+    ContainerHandle       handle;
+
+    // Names, user data, event callbacks and the mouse bookkeeping behind
+    // them, which only events, the importers and callbacks look at. Every
+    // container has one, allocated with it (in the container's arena for
+    // arena containers).
+    ContainerCold* cold = new ContainerCold;
 
     Container* child(int wanted_width, int wanted_height);
 
@@ -385,6 +494,14 @@ struct Container {
 
     Container(const Container& c);
 
+    // For imported containers, which don't need a uuid generated
+    struct Imported {};
+
+    Container(Imported);
+
+    // Same, placed in `arena` by arena_container, child list included
+    Container(Imported, ContainerArena* arena);
+
     bool skip_delete = false;
 
     virtual ~Container();
@@ -454,6 +571,16 @@ Bounds     scroll_bounds(Container* container);
 
 void       layout(Container* root, Container* container, const Bounds& bounds);
 
+// Makes the next layout() visit `container` and every container above it.
+// Needed after changing wanted_bounds, wanted_pad, children, exists, type or
+// anything else layout() reads, unless it is a container's own layout
+// callback changing that container. child() does it for the containers it
+// adds.
+void       mark_layout_dirty(Container* container);
+
+// Containers layout() laid out, rather than skipped, since this was last reset
+extern uint64_t containers_laid_out;
+
 Container* container_by_name(std::string name, Container* root);
 Container* container_by_name_up(std::string name, Container* root);
 
@@ -479,4 +606,8 @@ void       clamp_scroll(ScrollContainer* scrollpane);
 
 void       modify_all(Container* container, double x_change, double y_change);
 
+// real_bounds with the children_offset of every container above added, which
+// is where the container shows up on screen
+Bounds     screen_bounds(Container* container);
+
 #endif
@@ -0,0 +1,114 @@
+// containerdebug-convert: transcodes a log.json capture into a binary snapshot
+// log (snapshot.h) and reports how the two compare.
+//
+//   containerdebug-convert [--keyframe-interval N] log.json[.gz|.zst] [log.cdbg]
+
+#include "container.h"
+#include "loader.h"
+#include "snapshot.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// Steps imported at once, enough to keep every core busy without holding
+// the whole log in memory
+static constexpr int batch_steps = 256;
+
+static void wait_for_steps(LogLoader* loader) {
+    while (!loader->done)
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    loader_drain(loader);
+}
+
+// Imports every step of `loader`, handing each root to `use` before deleting
+// it, and returns the seconds spent importing
+template <typename Fn>
+static double import_all(LogLoader* loader, Fn use) {
+    double seconds = 0;
+    int    total   = (int)loader->steps.size();
+    for (int first = 0; first < total; first += batch_steps) {
+        auto start = std::chrono::steady_clock::now();
+        auto roots = loader_import(loader, first, batch_steps);
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        for (auto root : roots) {
+            use(root);
+            delete root;
+        }
+    }
+    return seconds;
+}
+
+int main(int argc, char* argv[]) {
+    SnapshotWriter writer;
+    int            arg = 1;
+    if (arg + 1 < argc && std::string(argv[arg]) == "--keyframe-interval") {
+        writer.keyframe_interval = atoi(argv[arg + 1]);
+        arg += 2;
+    }
+    if (arg >= argc || writer.keyframe_interval < 1) {
+        fprintf(stderr, "usage: %s [--keyframe-interval N] log.json [out.cdbg]\n", argv[0]);
+        return 2;
+    }
+    std::string in_path = argv[arg];
+    std::string out_path;
+    if (arg + 1 < argc) {
+        out_path = argv[arg + 1];
+    } else {
+        out_path = in_path;
+        for (auto suffix : {".gz", ".zst"}) {
+            if (out_path.ends_with(suffix))
+                out_path.resize(out_path.size() - strlen(suffix));
+        }
+        if (out_path.ends_with(".json"))
+            out_path.resize(out_path.size() - 5);
+        out_path += ".cdbg";
+    }
+
+    LogLoader in;
+    if (!loader_start(&in, in_path))
+        return 1;
+    wait_for_steps(&in);
+    if (in.format != json_lines) {
+        fprintf(stderr, "%s is already a snapshot log\n", in_path.c_str());
+        loader_stop(&in);
+        return 1;
+    }
+
+    if (!snapshot_write_begin(&writer, out_path)) {
+        fprintf(stderr, "Couldn't create %s\n", out_path.c_str());
+        loader_stop(&in);
+        return 1;
+    }
+    bool   written      = true;
+    long   nodes        = 0;
+    double json_seconds = import_all(&in, [&](Container* root) { written = snapshot_write_step(&writer, root) && written; });
+    written             = snapshot_write_end(&writer) && written;
+    size_t json_size    = in.file_size;
+    size_t steps        = in.steps.size();
+    loader_stop(&in);
+    if (!written) {
+        fprintf(stderr, "Couldn't write %s\n", out_path.c_str());
+        return 1;
+    }
+
+    LogLoader out;
+    if (!loader_start(&out, out_path))
+        return 1;
+    wait_for_steps(&out);
+    for (const auto& info : out.steps)
+        nodes += info.node_count;
+    double snapshot_seconds = import_all(&out, [](Container*) {});
+    size_t snapshot_size    = out.file_size;
+    loader_stop(&out);
+
+    printf("%zu steps, %ld nodes -> %s\n\n", steps, nodes, out_path.c_str());
+    printf("%-10s %12s %12s %14s\n", "format", "size (MB)", "load (s)", "nodes/s");
+    printf("%-10s %12.1f %12.3f %14.0f\n", "json", json_size / 1e6, json_seconds, nodes / json_seconds);
+    printf("%-10s %12.1f %12.3f %14.0f\n", "snapshot", snapshot_size / 1e6, snapshot_seconds, nodes / snapshot_seconds);
+    printf("\nsnapshot is %.1fx smaller and loads %.1fx faster\n", (double)json_size / snapshot_size, json_seconds / snapshot_seconds);
+    return 0;
+}
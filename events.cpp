@@ -53,7 +53,8 @@ void fill_list_with_pierced(std::vector<Container*>& containers, Container* pare
                     real_bounds_copy.h -= s->bottom->real_bounds.h;
                 if (!bounds_contains(real_bounds_copy, x, y))
                     continue;
-                fill_list_with_pierced(containers, child, x, y);
+                fill_list_with_pierced(containers, child, x - s->content->children_offset_x,
+                                       y - s->content->children_offset_y);
             }
         }
         if (s->right && s->right->exists)
@@ -68,7 +69,9 @@ void fill_list_with_pierced(std::vector<Container*>& containers, Container* pare
                 if (parent->type >= ::scrollpane && parent->type <= ::scrollpane_b_never)
                     if (!bounds_contains(parent->real_bounds, x, y))
                         continue;
-                fill_list_with_pierced(containers, child, x, y);
+                // The children are laid out where they'd be without the offset
+                fill_list_with_pierced(containers, child, x - parent->children_offset_x,
+                                       y - parent->children_offset_y);
             }
         }
     }
@@ -107,12 +110,12 @@ void handle_mouse_motion(Container* root, int x, int y) {
     ZoneScoped;
 #endif
     // Disabled because of scrolls
-    if (false && root->previous_x == x && root->previous_y == y)
+    if (false && root->cold->previous_x == x && root->cold->previous_y == y)
         return;
-    root->previous_x                  = root->mouse_current_x;
-    root->previous_y                  = root->mouse_current_y;
-    root->mouse_current_x             = x;
-    root->mouse_current_y             = y;
+    root->cold->previous_x      = root->cold->mouse_current_x;
+    root->cold->previous_y      = root->cold->mouse_current_y;
+    root->cold->mouse_current_x = x;
+    root->cold->mouse_current_y = y;
     std::vector<Container*> pierced   = pierced_containers(root, x, y);
     std::vector<Container*> concerned = concerned_containers(root);
 
@@ -140,34 +143,34 @@ void handle_mouse_motion(Container* root, int x, int y) {
 
         if (c->state.mouse_pressing || c->state.mouse_dragging) {
             if (c->state.mouse_dragging) {
-                auto move_distance_x = abs(root->mouse_initial_x - root->mouse_current_x);
-                auto move_distance_y = abs(root->mouse_initial_y - root->mouse_current_y);
-                if (move_distance_x >= c->minimum_x_distance_to_move_before_drag_begins || move_distance_y >= c->minimum_y_distance_to_move_before_drag_begins) {
+                auto move_distance_x = abs(root->cold->mouse_initial_x - root->cold->mouse_current_x);
+                auto move_distance_y = abs(root->cold->mouse_initial_y - root->cold->mouse_current_y);
+                if (move_distance_x >= c->cold->minimum_x_distance_to_move_before_drag_begins || move_distance_y >= c->cold->minimum_y_distance_to_move_before_drag_begins) {
                     // handle when_drag
-                    if (c->when_drag) {
-                        c->when_drag(root, c);
+                    if (c->cold->when_drag) {
+                        c->cold->when_drag(root, c);
                     }
                 }
             } else if (c->state.mouse_pressing) {
-                auto move_distance_x = abs(root->mouse_initial_x - root->mouse_current_x);
-                auto move_distance_y = abs(root->mouse_initial_y - root->mouse_current_y);
-                if (move_distance_x >= c->minimum_x_distance_to_move_before_drag_begins || move_distance_y >= c->minimum_y_distance_to_move_before_drag_begins) {
+                auto move_distance_x = abs(root->cold->mouse_initial_x - root->cold->mouse_current_x);
+                auto move_distance_y = abs(root->cold->mouse_initial_y - root->cold->mouse_current_y);
+                if (move_distance_x >= c->cold->minimum_x_distance_to_move_before_drag_begins || move_distance_y >= c->cold->minimum_y_distance_to_move_before_drag_begins) {
                     c->state.mouse_dragging = true;
-                    if (c->when_drag_start) {
-                        c->when_drag_start(root, c);
+                    if (c->cold->when_drag_start) {
+                        c->cold->when_drag_start(root, c);
                     }
                 }
             }
         } else if (in_pierced) {
             // handle when_mouse_motion
-            if (c->when_mouse_motion) {
-                c->when_mouse_motion(root, c);
+            if (c->cold->when_mouse_motion) {
+                c->cold->when_mouse_motion(root, c);
             }
         } else {
             // handle when_mouse_leaves_container
             c->state.mouse_hovering = false;
-            if (c->when_mouse_leaves_container) {
-                c->when_mouse_leaves_container(root, c);
+            if (c->cold->when_mouse_leaves_container) {
+                c->cold->when_mouse_leaves_container(root, c);
             }
             c->state.reset();
         }
@@ -184,20 +187,20 @@ void handle_mouse_motion(Container* root, int x, int y) {
     for (int i = 0; i < pierced.size(); i++) {
         auto p = pierced[i];
         bool non_top = i != 0;
-        //if (c->when_mouse_leaves_container && !p) {
-            //c->when_mouse_leaves_container(root, c);
+        //if (c->cold->when_mouse_leaves_container && !p) {
+            //c->cold->when_mouse_leaves_container(root, c);
         //}
  
         if (a_concerned_container_mouse_pressed && !p->state.concerned)
             continue;
 
-        if (non_top && (!p->receive_events_even_if_obstructed_by_one && !p->receive_events_even_if_obstructed)) {
+        if (non_top && (!p->cold->receive_events_even_if_obstructed_by_one && !p->cold->receive_events_even_if_obstructed)) {
             continue;
         }
         if (non_top) {
-            if (p->receive_events_even_if_obstructed) {
+            if (p->cold->receive_events_even_if_obstructed) {
 
-            } else if (p->receive_events_even_if_obstructed_by_one && p != pierced[0]->parent) {
+            } else if (p->cold->receive_events_even_if_obstructed_by_one && p != pierced[0]->parent) {
                 continue;
             }
         }
@@ -208,8 +211,8 @@ void handle_mouse_motion(Container* root, int x, int y) {
         // handle when_mouse_enters_container
         p->state.concerned      = true;
         p->state.mouse_hovering = true;
-        if (p->when_mouse_enters_container) {
-            p->when_mouse_enters_container(root, p);
+        if (p->cold->when_mouse_enters_container) {
+            p->cold->when_mouse_enters_container(root, p);
         }
     }
 }
@@ -228,17 +231,17 @@ void set_active(Container* root, const std::vector<Container*>& active_container
             }
         }
         if (will_be_activated) {
-            if (!s->content->active) {
-                s->content->active = true;
-                if (s->content->when_active_status_changed) {
-                    s->content->when_active_status_changed(root, s->content);
+            if (!s->content->cold->active) {
+                s->content->cold->active = true;
+                if (s->content->cold->when_active_status_changed) {
+                    s->content->cold->when_active_status_changed(root, s->content);
                 }
             }
         } else {
-            if (s->content->active) {
-                s->content->active = false;
-                if (s->content->when_active_status_changed) {
-                    s->content->when_active_status_changed(root, s->content);
+            if (s->content->cold->active) {
+                s->content->cold->active = false;
+                if (s->content->cold->when_active_status_changed) {
+                    s->content->cold->when_active_status_changed(root, s->content);
                 }
             }
         }
@@ -254,17 +257,17 @@ void set_active(Container* root, const std::vector<Container*>& active_container
             }
         }
         if (will_be_activated) {
-            if (!c->active) {
-                c->active = true;
-                if (c->when_active_status_changed) {
-                    c->when_active_status_changed(root, c);
+            if (!c->cold->active) {
+                c->cold->active = true;
+                if (c->cold->when_active_status_changed) {
+                    c->cold->when_active_status_changed(root, c);
                 }
             }
         } else {
-            if (c->active) {
-                c->active = false;
-                if (c->when_active_status_changed) {
-                    c->when_active_status_changed(root, c);
+            if (c->cold->active) {
+                c->cold->active = false;
+                if (c->cold->when_active_status_changed) {
+                    c->cold->when_active_status_changed(root, c);
                 }
             }
         }
@@ -277,12 +280,12 @@ void handle_mouse_button_press(Container* root, const Event& e) {
 #endif
     // TODOO wrong check
     if (e.button == BTN_LEFT)
-        root->left_mouse_down = true;
+        root->cold->left_mouse_down = true;
 
-    root->mouse_initial_x = e.x;
-    root->mouse_initial_y = e.y;
-    root->mouse_current_x = e.x;
-    root->mouse_current_y = e.y;
+    root->cold->mouse_initial_x = e.x;
+    root->cold->mouse_initial_y = e.y;
+    root->cold->mouse_current_x = e.x;
+    root->cold->mouse_current_y = e.y;
     std::vector<Container*> pierced   = pierced_containers(root, e.x, e.y);
     std::vector<Container*> concerned = concerned_containers(root);
 
@@ -293,7 +296,7 @@ void handle_mouse_button_press(Container* root, const Event& e) {
 
     std::vector<Container*> mouse_downed;
 
-    //notify(std::format("{} {} {} {}", e.scroll, pierced.size(), root->mouse_current_x, root->mouse_current_y));
+    //notify(std::format("{} {} {} {}", e.scroll, pierced.size(), root->cold->mouse_current_x, root->cold->mouse_current_y));
 
     for (int i = 0; i < pierced.size(); i++) {
         auto p = pierced[i];
@@ -301,13 +304,13 @@ void handle_mouse_button_press(Container* root, const Event& e) {
         // pierced[0] will always be the top or "real" container we are actually
         // clicking on therefore everyone else in the list needs to set
         // receive_events_even_if_obstructed to true to receive events
-        if (i != 0 && (!p->receive_events_even_if_obstructed_by_one && !p->receive_events_even_if_obstructed)) {
+        if (i != 0 && (!p->cold->receive_events_even_if_obstructed_by_one && !p->cold->receive_events_even_if_obstructed)) {
             continue;
         }
         if (i != 0) {
-            if (p->receive_events_even_if_obstructed) {
+            if (p->cold->receive_events_even_if_obstructed) {
 
-            } else if (p->receive_events_even_if_obstructed_by_one && p != pierced[0]->parent) {
+            } else if (p->cold->receive_events_even_if_obstructed_by_one && p != pierced[0]->parent) {
                 continue;
             }
         }
@@ -316,8 +319,8 @@ void handle_mouse_button_press(Container* root, const Event& e) {
 
         // Check if its a scroll event and call when_scrolled if so
         if (e.scroll) {
-            if (p->when_fine_scrolled) {
-                p->when_fine_scrolled(root, p, 0, -e.delta, e.from_mouse);
+            if (p->cold->when_fine_scrolled) {
+                p->cold->when_fine_scrolled(root, p, 0, -e.delta, e.from_mouse);
                 handle_mouse_motion(root, e.x, e.y);
             }
             continue;
@@ -333,10 +336,10 @@ void handle_mouse_button_press(Container* root, const Event& e) {
         p->state.mouse_pressing       = true;
         p->state.mouse_button_pressed = e.button;
 
-        if (p->when_mouse_down || p->when_key_event) {
+        if (p->cold->when_mouse_down || p->cold->when_key_event) {
             mouse_downed.push_back(p);
-            if (p->when_mouse_down) {
-                p->when_mouse_down(root, p);
+            if (p->cold->when_mouse_down) {
+                p->cold->when_mouse_down(root, p);
             }
         }
     }
@@ -352,10 +355,10 @@ bool handle_mouse_button_release(Container* root, const Event& e) {
     }
 
     if (e.button == BTN_LEFT)
-        root->left_mouse_down = false;
+        root->cold->left_mouse_down = false;
 
-    root->mouse_current_x             = e.x;
-    root->mouse_current_y             = e.y;
+    root->cold->mouse_current_x = e.x;
+    root->cold->mouse_current_y = e.y;
     std::vector<Container*> concerned = concerned_containers(root);
     std::vector<Container*> pierced   = pierced_containers(root, e.x, e.y);
 
@@ -365,32 +368,32 @@ bool handle_mouse_button_release(Container* root, const Event& e) {
     // when_mouse_up, when_drag_end, and_when_clicked
 
     for (int i = 0; i < concerned.size(); i++) {
-        auto                c           = concerned[i];
-        std::weak_ptr<bool> still_alive = c->lifetime;
-        bool                p           = is_pierced(c, pierced);
+        auto            c           = concerned[i];
+        ContainerHandle still_alive = c->handle;
+        bool            p           = is_pierced(c, pierced);
 
-        if (c->when_mouse_leaves_container && !p) {
-            c->when_mouse_leaves_container(root, c);
+        if (c->cold->when_mouse_leaves_container && !p) {
+            c->cold->when_mouse_leaves_container(root, c);
         }
-        if (!still_alive.lock())
+        if (!container_alive(still_alive))
             continue;
 
-        if (c->when_drag_end) {
+        if (c->cold->when_drag_end) {
             if (c->state.mouse_dragging) {
-                c->when_drag_end(root, c);
+                c->cold->when_drag_end(root, c);
             }
         }
-        if (!still_alive.lock())
+        if (!container_alive(still_alive))
             continue;
 
-        if (c->when_clicked) {
-            if (c->when_drag_end_is_click && c->state.mouse_dragging && p) {
-                c->when_clicked(root, c);
+        if (c->cold->when_clicked) {
+            if (c->cold->when_drag_end_is_click && c->state.mouse_dragging && p) {
+                c->cold->when_clicked(root, c);
             } else if ((!c->state.mouse_dragging)) {
-                c->when_clicked(root, c);
+                c->cold->when_clicked(root, c);
             }
         }
-        if (!still_alive.lock())
+        if (!container_alive(still_alive))
             continue;
 
         // TODO: when_clicked could've delete'd 'c' so recheck for it
@@ -452,7 +455,8 @@ void paint_outline(Container* root, Container* c) {
         });
         
         for (auto index: render_order) {
-            if (overlaps(s->content->children[index]->real_bounds, s->real_bounds)) {
+            // On screen, where children_offset has moved them, like hit testing
+            if (overlaps(screen_bounds(s->content->children[index]), screen_bounds(s))) {
                 paint_outline(root, s->content->children[index]);
             }
         }
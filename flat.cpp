@@ -0,0 +1,69 @@
+#include "flat.h"
+
+static uint32_t flatten_node(FlatTree* flat, const Container* c, uint32_t parent, uint32_t depth) {
+    auto index = (uint32_t)flat->nodes.size();
+    {
+        FlatNode& node   = flat->nodes.emplace_back();
+        node.real_bounds = c->real_bounds;
+        node.uuid_id     = c->uuid_id;
+        node.exists      = c->exists;
+        node.depth       = depth;
+        node.parent      = parent;
+        node.source      = c;
+    }
+
+    // Children come right after their parent, so `nodes` may grow meanwhile
+    uint32_t previous = flat_none;
+    for (auto child : c->children) {
+        uint32_t child_index = flatten_node(flat, child, index, depth + 1);
+        if (previous == flat_none)
+            flat->nodes[index].first_child = child_index;
+        else
+            flat->nodes[previous].next_sibling = child_index;
+        previous = child_index;
+    }
+    flat->nodes[index].subtree = (uint32_t)flat->nodes.size() - index;
+    return index;
+}
+
+void flatten_tree(FlatTree* flat, const Container* root) {
+    flat->nodes.clear();
+    if (root)
+        flatten_node(flat, root, flat_none, 0);
+}
+
+// Imported containers are plain interactable boxes (no scroll panes, no
+// handles_pierced), so only `exists` and the bounds decide. A pierced node
+// is held back until the walk leaves its subtree, which puts it after all
+// of its pierced descendants like fill_list_with_pierced does.
+std::vector<uint32_t> flat_pierced(const FlatTree* flat, int x, int y) {
+    std::vector<uint32_t> pierced;
+    std::vector<uint32_t> open;
+    auto&                 nodes = flat->nodes;
+    auto                  count = (uint32_t)nodes.size();
+    for (uint32_t i = 0; i < count;) {
+        while (!open.empty() && open.back() + nodes[open.back()].subtree <= i) {
+            pierced.push_back(open.back());
+            open.pop_back();
+        }
+        if (!nodes[i].exists) {
+            i += nodes[i].subtree;
+            continue;
+        }
+        if (bounds_contains(nodes[i].real_bounds, x, y))
+            open.push_back(i);
+        i++;
+    }
+    while (!open.empty()) {
+        pierced.push_back(open.back());
+        open.pop_back();
+    }
+    return pierced;
+}
+
+uint32_t flat_by_uuid_id(const FlatTree* flat, uint32_t uuid_id) {
+    for (uint32_t i = 0; i < flat->nodes.size(); i++)
+        if (flat->nodes[i].uuid_id == uuid_id)
+            return i;
+    return flat_none;
+}
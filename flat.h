@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "container.h"
+
+// A read-only copy of an imported step, with its nodes in one array in
+// pre-order instead of behind child pointers. The viewer walks the step it
+// shows several times a frame (painting, hit testing, looking up the
+// selection), and each walk over the flat copy is a single pass over
+// contiguous memory. Links between nodes are indices into `nodes`.
+//
+// A subtree is the run of `subtree` nodes starting at its root, so skipping
+// one is a single add.
+
+static constexpr uint32_t flat_none = UINT32_MAX;
+
+struct FlatNode {
+    Bounds   real_bounds;
+    uint32_t uuid_id = 0;
+    bool     exists  = true;
+
+    // Distance from the root, which is at 0
+    uint32_t depth = 0;
+
+    // flat_none where there is no such node
+    uint32_t parent       = flat_none;
+    uint32_t first_child  = flat_none;
+    uint32_t next_sibling = flat_none;
+
+    // Nodes in the subtree rooted here, this one included
+    uint32_t subtree = 1;
+
+    // The node this one was copied from, for the fields not copied here. Only
+    // valid while the tree it came from is.
+    const Container* source = nullptr;
+};
+
+struct FlatTree {
+    std::vector<FlatNode> nodes;
+};
+
+// Replaces the contents of `flat` with a copy of the tree under `root`
+// (nothing for null). Nodes shared between parents (share.h) are copied once
+// per parent.
+void                  flatten_tree(FlatTree* flat, const Container* root);
+
+// Same as pierced_containers on the tree that was flattened: the nodes under
+// x and y, deepest first
+std::vector<uint32_t> flat_pierced(const FlatTree* flat, int x, int y);
+
+// First node in pre-order with the given interned uuid, flat_none if there is
+// none. Imported containers have no names, so this takes the place of
+// container_by_name.
+uint32_t              flat_by_uuid_id(const FlatTree* flat, uint32_t uuid_id);
@@ -0,0 +1,558 @@
+#include "import.h"
+
+#include "arena.h"
+#include "container.h"
+#include "intern.h"
+#include "scan.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <string_view>
+
+// One logged key and where its value goes. Exactly one of the accessors is
+// set, except for "id" and "children" which the importers handle themselves.
+struct Field {
+  enum Kind { id, number, flag, children };
+
+  std::string_view key;
+  Kind kind;
+  double &(*real)(Container *c) = nullptr;
+  int &(*integer)(Container *c) = nullptr;
+  bool &(*boolean)(Container *c) = nullptr;
+};
+
+// Every key the importers understand. Adding a field to the log format only
+// takes a line here.
+static constexpr Field fields[] = {
+    {"id", Field::id},
+    {"x", Field::number, [](Container *c) -> double & { return c->real_bounds.x; }},
+    {"y", Field::number, [](Container *c) -> double & { return c->real_bounds.y; }},
+    {"w", Field::number, [](Container *c) -> double & { return c->real_bounds.w; }},
+    {"h", Field::number, [](Container *c) -> double & { return c->real_bounds.h; }},
+    {"active", Field::flag, nullptr, nullptr, [](Container *c) -> bool & { return c->cold->active; }},
+    {"concerned", Field::flag, nullptr, nullptr, [](Container *c) -> bool & { return c->state.concerned; }},
+    {"exists", Field::flag, nullptr, nullptr, [](Container *c) -> bool & { return c->exists; }},
+    {"mouse_hovering", Field::flag, nullptr, nullptr, [](Container *c) -> bool & { return c->state.mouse_hovering; }},
+    {"mouse_pressing", Field::flag, nullptr, nullptr, [](Container *c) -> bool & { return c->state.mouse_pressing; }},
+    {"mouse_dragging", Field::flag, nullptr, nullptr, [](Container *c) -> bool & { return c->state.mouse_dragging; }},
+    {"mouse_button_pressed", Field::number, nullptr, [](Container *c) -> int & { return c->state.mouse_button_pressed; }},
+    {"mouse_current_x", Field::number, nullptr, [](Container *c) -> int & { return c->cold->mouse_current_x; }},
+    {"mouse_current_y", Field::number, nullptr, [](Container *c) -> int & { return c->cold->mouse_current_y; }},
+    {"mouse_initial_x", Field::number, nullptr, [](Container *c) -> int & { return c->cold->mouse_initial_x; }},
+    {"mouse_initial_y", Field::number, nullptr, [](Container *c) -> int & { return c->cold->mouse_initial_y; }},
+    {"previous_x", Field::number, nullptr, [](Container *c) -> int & { return c->cold->previous_x; }},
+    {"previous_y", Field::number, nullptr, [](Container *c) -> int & { return c->cold->previous_y; }},
+    {"spacing", Field::number, [](Container *c) -> double & { return c->spacing; }},
+    {"scroll_h_real", Field::number, [](Container *c) -> double & { return c->scroll_h_real; }},
+    {"scroll_v_real", Field::number, [](Container *c) -> double & { return c->scroll_v_real; }},
+    {"children", Field::children},
+};
+
+static constexpr size_t field_count = sizeof(fields) / sizeof(fields[0]);
+
+struct KeyTable {
+  static constexpr uint32_t bits = 6;
+  static constexpr uint32_t size = 1 << bits;
+
+  uint32_t multiplier = 0;
+  int8_t slots[size] = {};
+};
+
+// Keys are looked up in a small perfect hash built at compile time: FNV-1a of
+// the key, times the first odd multiplier that sends every key in the table to
+// its own slot
+static constexpr uint32_t key_slot(std::string_view key, uint32_t multiplier) {
+  uint32_t hash = 2166136261u;
+  for (char ch : key)
+    hash = (hash ^ (unsigned char) ch) * 16777619u;
+  return (hash * multiplier) >> (32 - KeyTable::bits);
+}
+
+static constexpr KeyTable make_key_table() {
+  static_assert(field_count < KeyTable::size);
+  for (uint32_t multiplier = 1; multiplier < 100000; multiplier += 2) {
+    KeyTable table;
+    table.multiplier = multiplier;
+    for (auto &slot : table.slots)
+      slot = -1;
+    bool collided = false;
+    for (size_t i = 0; i < field_count && !collided; i++) {
+      auto &slot = table.slots[key_slot(fields[i].key, multiplier)];
+      collided = slot != -1;
+      slot = (int8_t) i;
+    }
+    if (!collided)
+      return table;
+  }
+  return {};
+}
+
+static constexpr KeyTable key_table = make_key_table();
+static_assert(key_table.multiplier != 0, "no perfect hash for the field table");
+
+static const Field *field_for_key(std::string_view key) {
+  int i = key_table.slots[key_slot(key, key_table.multiplier)];
+  return i >= 0 && fields[i].key == key ? &fields[i] : nullptr;
+}
+
+// A container with the defaults the log format uses for missing keys, which
+// aren't the same as Container's own. On the heap when `arena` is null.
+static Container *new_imported_container(ContainerArena *arena) {
+  auto *c = arena_container(arena);
+  c->exists = false;
+  c->cold->mouse_current_x = 0;
+  c->cold->mouse_current_y = 0;
+  c->cold->mouse_initial_x = 0;
+  c->cold->mouse_initial_y = 0;
+  c->cold->previous_x = 0;
+  c->cold->previous_y = 0;
+  return c;
+}
+
+// Numbers are read as ints, the same as j.value(key, 0) used to
+static void set_number(Container *c, const Field *field, int v) {
+  if (field->real)
+    field->real(c) = v;
+  else
+    field->integer(c) = v;
+}
+
+// A number, true, false, null or string as the streaming importers read it
+struct Scalar {
+  enum Type { null, boolean, number, string };
+
+  Type type = null;
+  int integer = 0;
+  bool flag = false;
+  std::string_view text = {};
+};
+
+static const char *type_name(Scalar::Type type) {
+  switch (type) {
+  case Scalar::null: return "null";
+  case Scalar::boolean: return "boolean";
+  case Scalar::number: return "number";
+  case Scalar::string: return "string";
+  }
+  return "";
+}
+
+// What import_container(const json &) reads a field's value as
+static const char *type_name(Field::Kind kind) {
+  switch (kind) {
+  case Field::id: return "string";
+  case Field::number: return "number";
+  case Field::flag: return "boolean";
+  case Field::children: return "array";
+  }
+  return "";
+}
+
+// Stores a scalar the way import_container(const json &) does, which the
+// streaming importers have to agree with. Returns false where that throws:
+// null anywhere but "children", and values of the wrong type. Booleans are
+// numbers too (0 or 1), as get<int>() reads them. Unknown keys take anything.
+static bool set_field(Container *c, const Field *field, const Scalar &v) {
+  if (!field)
+    return true;
+  switch (field->kind) {
+  case Field::id:
+    if (v.type != Scalar::string)
+      return false;
+    c->uuid_id = intern(v.text);
+    return true;
+  case Field::number:
+    if (v.type != Scalar::number && v.type != Scalar::boolean)
+      return false;
+    set_number(c, field, v.type == Scalar::boolean ? v.flag : v.integer);
+    return true;
+  case Field::flag:
+    if (v.type != Scalar::boolean)
+      return false;
+    field->boolean(c) = v.flag;
+    return true;
+  case Field::children:
+    // Looping over null is looping over nothing
+    return v.type == Scalar::null;
+  }
+  return false;
+}
+
+Container *import_container(const nlohmann::json &j) {
+  auto *c = new_imported_container(nullptr);
+  try {
+    // Throws for anything but an object, like j.value() did
+    for (const auto &[key, value] : j.get_ref<const nlohmann::json::object_t &>()) {
+      const Field *field = field_for_key(key);
+      if (!field)
+        continue;
+      // get<>() throws on a value of the wrong type, as above
+      switch (field->kind) {
+      case Field::id: c->uuid_id = intern(value.get<std::string>()); break;
+      case Field::number: set_number(c, field, value.get<int>()); break;
+      case Field::flag: field->boolean(c) = value.get<bool>(); break;
+      case Field::children:
+        for (const auto &child_json : value)
+          c->children.push_back(import_container(child_json));
+        break;
+      }
+    }
+  } catch (...) {
+    delete c;
+    throw;
+  }
+  return c;
+}
+
+struct ImportSax : nlohmann::json_sax<nlohmann::json> {
+  struct Frame {
+    Container *container;
+    // True while inside the container's "children" array
+    bool in_children;
+  };
+
+  ContainerArena *arena = nullptr;
+  Container *root = nullptr;
+  std::vector<Frame> stack;
+  const Field *field = nullptr;
+
+  // Depth inside a value nobody reads
+  int skipping = 0;
+
+  // Throws what import_container(const json &) would for a value of type
+  // `is` where it is
+  [[noreturn]] void mismatch(const char *is) const {
+    const char *expected = stack.empty() || stack.back().in_children ? "object" : type_name(field->kind);
+    throw nlohmann::json::type_error::create(302, std::string("type must be ") + expected + ", but is " + is, nullptr);
+  }
+
+  bool scalar(const Scalar &v) {
+    if (skipping)
+      return true;
+    if (stack.empty() || stack.back().in_children || !set_field(stack.back().container, field, v))
+      mismatch(type_name(v.type));
+    return true;
+  }
+
+  bool null() override { return scalar({Scalar::null}); }
+
+  bool boolean(bool v) override { return scalar({Scalar::boolean, 0, v}); }
+
+  bool number_integer(number_integer_t v) override { return scalar({Scalar::number, (int) v}); }
+
+  bool number_unsigned(number_unsigned_t v) override { return scalar({Scalar::number, (int) v}); }
+
+  bool number_float(number_float_t v, const string_t &) override { return scalar({Scalar::number, (int) v}); }
+
+  bool string(string_t &v) override { return scalar({Scalar::string, 0, false, v}); }
+
+  bool binary(binary_t &) override { return true; }
+
+  bool start_object(std::size_t) override {
+    if (skipping) {
+      skipping++;
+    } else if (stack.empty()) {
+      root = new_imported_container(arena);
+      stack.push_back({root, false});
+    } else if (stack.back().in_children) {
+      auto *child = new_imported_container(arena);
+      stack.back().container->children.push_back(child);
+      stack.push_back({child, false});
+    } else if (field && field->kind != Field::children) {
+      mismatch("object");
+    } else if (field) {
+      // The DOM importer loops over an object's values like an array's, so
+      // its values are children too. It goes by sorted key and this by the
+      // order in the text, but logs never have one.
+      stack.push_back({stack.back().container, true});
+    } else {
+      skipping = 1;
+    }
+    return true;
+  }
+
+  bool key(string_t &v) override {
+    if (!skipping)
+      field = field_for_key(v);
+    return true;
+  }
+
+  bool end_object() override {
+    if (skipping)
+      skipping--;
+    else
+      stack.pop_back();
+    return true;
+  }
+
+  bool start_array(std::size_t) override {
+    if (skipping) {
+      skipping++;
+    } else if (stack.empty() || stack.back().in_children || (field && field->kind != Field::children)) {
+      mismatch("array");
+    } else if (field) {
+      stack.push_back({stack.back().container, true});
+    } else {
+      skipping = 1;
+    }
+    return true;
+  }
+
+  bool end_array() override {
+    if (skipping)
+      skipping--;
+    else
+      stack.pop_back();
+    return true;
+  }
+
+  // The parser only reports these two; rethrown as themselves so the
+  // callers see what the DOM parser would have thrown
+  bool parse_error(std::size_t, const std::string &, const nlohmann::detail::exception &e) override {
+    if (auto *parse = dynamic_cast<const nlohmann::detail::parse_error *>(&e))
+      throw *parse;
+    throw dynamic_cast<const nlohmann::detail::out_of_range &>(e);
+  }
+};
+
+// The fast path: a decoder for the shape logs actually have, reading values
+// off the structure scan_structure found instead of going byte by byte. It
+// gives up on anything it isn't sure the SAX parser would read the same way.
+struct FastImport {
+  const char *text;
+  const uint32_t *at;
+  size_t count;
+  ContainerArena *arena;
+
+  // Next structural character, and where the text after the last one starts
+  size_t next = 0;
+  size_t pos = 0;
+
+  // Objects and arrays currently open. Very deep nesting is left to the SAX
+  // parser, which doesn't recurse.
+  int depth = 0;
+};
+
+static constexpr int fast_max_depth = 1024;
+
+static bool is_blank(char ch) { return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r'; }
+
+static bool blank(const char *begin, const char *end) {
+  for (; begin < end; begin++)
+    if (!is_blank(*begin))
+      return false;
+  return true;
+}
+
+// The next structural character if only whitespace comes before it, else 0
+static char peek(const FastImport *f) {
+  if (f->next >= f->count || !blank(f->text + f->pos, f->text + f->at[f->next]))
+    return 0;
+  return f->text[f->at[f->next]];
+}
+
+static char take(FastImport *f) {
+  char ch = peek(f);
+  if (ch) {
+    f->pos = f->at[f->next] + 1;
+    f->next++;
+  }
+  return ch;
+}
+
+// Both quotes of a string are structural, and nothing in between
+static bool take_string(FastImport *f, std::string_view *s) {
+  if (take(f) != '"' || f->next >= f->count)
+    return false;
+  uint32_t close = f->at[f->next++];
+  *s = std::string_view(f->text + f->pos, close - f->pos);
+  f->pos = close + 1;
+  return true;
+}
+
+// A number, true, false or null that sits between two structural characters.
+// Numbers too large for an int, and values of the wrong type for `field`, are
+// left to the SAX parser.
+static bool fast_scalar(const char *begin, const char *end, const Field *field, Container *c) {
+  while (begin < end && is_blank(*begin))
+    begin++;
+  while (end > begin && is_blank(end[-1]))
+    end--;
+  if (begin == end)
+    return false;
+  if (*begin != '-' && (*begin < '0' || *begin > '9')) {
+    std::string_view text(begin, end - begin);
+    if (text == "true" || text == "false")
+      return set_field(c, field, {Scalar::boolean, 0, text == "true"});
+    return text == "null" && set_field(c, field, {Scalar::null});
+  }
+
+  // -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+  const char *p = begin;
+  if (p < end && *p == '-')
+    p++;
+  const char *digits = p;
+  while (p < end && *p >= '0' && *p <= '9')
+    p++;
+  size_t int_digits = p - digits;
+  if (int_digits == 0 || (int_digits > 1 && *digits == '0'))
+    return false;
+  bool integer = true;
+  if (p < end && *p == '.') {
+    const char *fraction = ++p;
+    while (p < end && *p >= '0' && *p <= '9')
+      p++;
+    if (p == fraction)
+      return false;
+    integer = false;
+  }
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    p++;
+    if (p < end && (*p == '+' || *p == '-'))
+      p++;
+    const char *exponent = p;
+    while (p < end && *p >= '0' && *p <= '9')
+      p++;
+    if (p == exponent)
+      return false;
+    integer = false;
+  }
+  if (p != end)
+    return false;
+
+  int v;
+  if (integer) {
+    if (int_digits > 18)
+      return false;
+    int64_t n = 0;
+    for (const char *d = digits; d < p; d++)
+      n = n * 10 + (*d - '0');
+    v = (int) (*begin == '-' ? -n : n);
+  } else {
+    double d;
+    if (std::from_chars(begin, end, d).ec != std::errc() || !(std::fabs(d) < 2147483648.0))
+      return false;
+    v = (int) d;
+  }
+  return set_field(c, field, {Scalar::number, v});
+}
+
+static bool fast_object(FastImport *f, Container *c);
+static bool fast_array(FastImport *f, Container *parent);
+
+// A value after a key (or in an array). Only values for known fields of an
+// actual container are stored, everything else is checked and dropped.
+static bool fast_value(FastImport *f, const Field *field, Container *c) {
+  switch (peek(f)) {
+  case '"': {
+    std::string_view s;
+    return take_string(f, &s) && set_field(c, field, {Scalar::string, 0, false, s});
+  }
+  case '{':
+    if (field)
+      return false;
+    take(f);
+    return fast_object(f, nullptr);
+  case '[':
+    if (field && field->kind != Field::children)
+      return false;
+    take(f);
+    return fast_array(f, field ? c : nullptr);
+  default:
+    // The scalar runs up to the , } or ] after it
+    if (f->next >= f->count)
+      return false;
+    if (!fast_scalar(f->text + f->pos, f->text + f->at[f->next], field, c))
+      return false;
+    f->pos = f->at[f->next];
+    return true;
+  }
+}
+
+// After the {. Keys of a null `c` are skipped.
+static bool fast_object(FastImport *f, Container *c) {
+  if (++f->depth > fast_max_depth)
+    return false;
+  if (peek(f) == '}') {
+    f->depth--;
+    return take(f);
+  }
+  while (true) {
+    std::string_view key;
+    if (!take_string(f, &key) || take(f) != ':')
+      return false;
+    if (!fast_value(f, c ? field_for_key(key) : nullptr, c))
+      return false;
+    char ch = take(f);
+    if (ch == '}') {
+      f->depth--;
+      return true;
+    }
+    if (ch != ',')
+      return false;
+  }
+}
+
+// After the [. Objects in it become children of `parent`, unless it is null;
+// anything else in a list of children is left to the SAX parser to reject.
+static bool fast_array(FastImport *f, Container *parent) {
+  if (++f->depth > fast_max_depth)
+    return false;
+  if (peek(f) == ']') {
+    f->depth--;
+    return take(f);
+  }
+  while (true) {
+    if (parent && peek(f) == '{') {
+      take(f);
+      auto *child = new_imported_container(f->arena);
+      parent->children.push_back(child);
+      if (!fast_object(f, child))
+        return false;
+    } else if (parent || !fast_value(f, nullptr, nullptr)) {
+      return false;
+    }
+    char ch = take(f);
+    if (ch == ']') {
+      f->depth--;
+      return true;
+    }
+    if (ch != ',')
+      return false;
+  }
+}
+
+Container *import_container_scanned(const char *begin, const char *end, ContainerArena *arena) {
+  thread_local std::vector<uint32_t> structure;
+  if (!scan_structure(begin, end, &structure))
+    return nullptr;
+
+  FastImport f = {begin, structure.data(), structure.size(), arena};
+  if (take(&f) != '{')
+    return nullptr;
+  Container *root = new_imported_container(arena);
+  if (!fast_object(&f, root) || f.next != f.count || !blank(begin + f.pos, end)) {
+    discard_tree(root);
+    return nullptr;
+  }
+  return root;
+}
+
+Container *import_container(const char *begin, const char *end, ContainerArena *arena) {
+  if (Container *c = import_container_scanned(begin, end, arena))
+    return c;
+  return import_container_sax(begin, end, arena);
+}
+
+Container *import_container_sax(const char *begin, const char *end, ContainerArena *arena) {
+  ImportSax sax;
+  sax.arena = arena;
+  try {
+    nlohmann::json::sax_parse(begin, end, &sax);
+  } catch (...) {
+    discard_tree(sax.root);
+    throw;
+  }
+  return sax.root;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "json.hpp"
+
+struct Container;
+struct ContainerArena;
+
+// Builds the Container tree described by one logged snapshot (a single line of
+// log.json). The returned tree is owned by the caller.
+Container *import_container(const nlohmann::json &j);
+
+// Same result as above, but read straight from the text in [begin, end)
+// without building a DOM: through import_container_scanned when it can, the
+// SAX parser below otherwise. Throws nlohmann::json::exception on malformed
+// input. With an `arena`, the tree is built in it and belongs to it instead of
+// the caller.
+Container *import_container(const char *begin, const char *end, ContainerArena *arena = nullptr);
+
+// The fast path of the above on its own: a schema specific decoder on top of
+// scan_structure. Returns nullptr, rather than throwing, for anything it
+// leaves to the SAX parser (escapes, non-ASCII text, huge numbers, errors).
+Container *import_container_scanned(const char *begin, const char *end, ContainerArena *arena = nullptr);
+
+// The SAX parser the fast path falls back to, on its own
+Container *import_container_sax(const char *begin, const char *end, ContainerArena *arena = nullptr);
@@ -0,0 +1,52 @@
+#include "intern.h"
+
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+struct StringPool {
+    std::shared_mutex mutex;
+
+    // A deque never moves its elements, so ids, views and references handed
+    // out stay good as it grows
+    std::deque<std::string>                        strings = {""};
+    std::unordered_map<std::string_view, uint32_t> ids     = {{strings[0], 0}};
+};
+
+static StringPool& string_pool() {
+    static StringPool pool;
+    return pool;
+}
+
+uint32_t intern(std::string_view text) {
+    auto& p = string_pool();
+    {
+        // Nearly every uuid was seen before, so look without blocking others
+        std::shared_lock lock(p.mutex);
+        auto             found = p.ids.find(text);
+        if (found != p.ids.end())
+            return found->second;
+    }
+
+    std::unique_lock lock(p.mutex);
+    auto             found = p.ids.find(text);
+    if (found != p.ids.end())
+        return found->second;
+    auto id = (uint32_t)p.strings.size();
+    p.strings.emplace_back(text);
+    p.ids.emplace(p.strings.back(), id);
+    return id;
+}
+
+const std::string& interned(uint32_t id) {
+    auto&            p = string_pool();
+    std::shared_lock lock(p.mutex);
+    return id < p.strings.size() ? p.strings[id] : p.strings[0];
+}
+
+size_t interned_count() {
+    auto&            p = string_pool();
+    std::shared_lock lock(p.mutex);
+    return p.strings.size();
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Process wide table of container uuids. The same uuid shows up in thousands
+// of steps, so imported containers store a small id (Container::uuid_id)
+// instead of their own copies of the text, and compare ids.
+//
+// Safe to use from several threads at once.
+
+// The id of `text`, adding it the first time it's seen. "" is always 0.
+uint32_t           intern(std::string_view text);
+
+// The text of an id intern returned. The reference stays valid for the life
+// of the process.
+const std::string& interned(uint32_t id);
+
+// How many distinct strings have been interned
+size_t             interned_count();
@@ -0,0 +1,686 @@
+#include "loader.h"
+
+#include "arena.h"
+#include "container.h"
+#include "import.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Lines are handed over in batches so the UI thread isn't fighting for the
+// lock on every newline
+static constexpr size_t publish_batch = 4096;
+
+// Address space reserved for data that grows after loader_start: a followed
+// log, or what a compressed log decodes to
+static constexpr size_t grow_reserve = (size_t)64 << 30;
+
+// Bytes scanned for newlines, or decoded, between progress updates
+static constexpr size_t scan_chunk = 1 << 20;
+
+// Compressed logs whose frames all decode to at most this much are decoded a
+// frame at a time when reopened
+static constexpr uint64_t seekable_frame_size = 16 << 20;
+
+// How often a followed log is checked when no inotify event wakes us first
+static constexpr int follow_poll_ms = 250;
+
+// Bump whenever StepInfo, LogFrame or IndexHeader change
+static constexpr uint32_t index_version = 2;
+
+struct IndexHeader {
+    char     magic[8] = {'C', 'D', 'B', 'G', 'I', 'D', 'X', '\0'};
+    uint32_t version  = index_version;
+    // Catches an index written on a machine with a different byte order
+    uint32_t byte_order = 0x01020304;
+    uint64_t log_size   = 0;
+    int64_t  log_mtime_ns = 0;
+    uint64_t step_count   = 0;
+
+    // For compressed logs; frames follow the steps
+    uint64_t decoded_size = 0;
+    uint64_t frame_count  = 0;
+};
+
+static std::string index_path(const std::string& log_path) {
+    return log_path + ".idx";
+}
+
+static uint64_t fnv1a(const char* data, size_t length) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// Counts the objects on a line (one per container) and picks the root's
+// x/y/w/h out of it without building any JSON
+static void summarize_step(const char* data, StepInfo* info) {
+    const char* p     = data + info->offset;
+    const char* end   = p + info->length;
+    int         depth = 0;
+    char        key   = 0; // the last one letter key seen directly on the root
+
+    info->hash       = fnv1a(p, info->length);
+    info->node_count = 0;
+    for (; p < end; p++) {
+        switch (*p) {
+            case '"': {
+                const char* start = ++p;
+                while (p < end && *p != '"') {
+                    if (*p == '\\')
+                        p++;
+                    p++;
+                }
+                key = (depth == 1 && p - start == 1) ? *start : 0;
+                break;
+            }
+            case '{':
+                info->node_count++;
+                depth++;
+                break;
+            case '[':
+                depth++;
+                break;
+            case '}':
+            case ']':
+                depth--;
+                break;
+            case ':': {
+                int slot = key == 'x' ? 0 : key == 'y' ? 1 : key == 'w' ? 2 : key == 'h' ? 3 : -1;
+                if (slot != -1) {
+                    while (p + 1 < end && p[1] == ' ')
+                        p++;
+                    std::from_chars(p + 1, end, info->root_bounds[slot]);
+                }
+                key = 0;
+                break;
+            }
+        }
+    }
+}
+
+static bool load_index(LogLoader* loader, std::vector<StepInfo>& steps, std::vector<LogFrame>& frames, uint64_t* decoded_size) {
+    FILE* file = fopen(index_path(loader->path).c_str(), "rb");
+    if (!file)
+        return false;
+
+    IndexHeader expected;
+    IndexHeader header;
+    bool        valid = fread(&header, sizeof(header), 1, file) == 1 &&
+                 memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0 &&
+                 header.version == expected.version && header.byte_order == expected.byte_order &&
+                 header.log_size == loader->file_size && header.log_mtime_ns == loader->mtime_ns;
+    if (valid) {
+        steps.resize(header.step_count);
+        frames.resize(header.frame_count);
+        valid = fread(steps.data(), sizeof(StepInfo), steps.size(), file) == steps.size() &&
+                (frames.empty() || fread(frames.data(), sizeof(LogFrame), frames.size(), file) == frames.size());
+        *decoded_size = header.decoded_size;
+    }
+    fclose(file);
+
+    if (!valid) {
+        steps.clear();
+        frames.clear();
+    }
+    return valid;
+}
+
+// Written to a temporary file first so a crash can't leave a truncated index
+// that still matches the log
+static void save_index(LogLoader* loader, const std::vector<StepInfo>& steps, const std::vector<LogFrame>& frames) {
+    auto  path = index_path(loader->path);
+    auto  temp = path + ".tmp";
+    FILE* file = fopen(temp.c_str(), "wb");
+    if (!file) {
+        fprintf(stderr, "Couldn't write index: %s (%s)\n", temp.c_str(), strerror(errno));
+        return;
+    }
+
+    IndexHeader header;
+    header.log_size     = loader->file_size;
+    header.log_mtime_ns = loader->mtime_ns;
+    header.step_count   = steps.size();
+    header.decoded_size = loader->size;
+    header.frame_count  = frames.size();
+    bool written        = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(steps.data(), sizeof(StepInfo), steps.size(), file) == steps.size() &&
+                   (frames.empty() || fwrite(frames.data(), sizeof(LogFrame), frames.size(), file) == frames.size());
+    written = fclose(file) == 0 && written;
+
+    if (!written || rename(temp.c_str(), path.c_str()) != 0) {
+        fprintf(stderr, "Couldn't write index: %s\n", path.c_str());
+        unlink(temp.c_str());
+    }
+}
+
+static void publish(LogLoader* loader, std::vector<StepInfo>& batch) {
+    if (batch.empty())
+        return;
+    std::lock_guard lock(loader->mutex);
+    loader->pending.insert(loader->pending.end(), batch.begin(), batch.end());
+    batch.clear();
+}
+
+// Adds a step for every line that ends in [pos, end) and returns where the
+// first unfinished line starts. With `last` set, whatever follows the final
+// newline is a line too.
+static size_t scan_lines(LogLoader* loader, size_t pos, size_t end, bool last, std::vector<StepInfo>& steps, std::vector<StepInfo>& batch) {
+    const char* data = loader->data;
+    while (pos < end) {
+        auto newline = (const char*)memchr(data + pos, '\n', end - pos);
+        if (!newline && !last)
+            break;
+        size_t line_end = newline ? newline - data : end;
+        if (line_end > pos) {
+            StepInfo info;
+            info.offset = pos;
+            info.length = line_end - pos;
+            steps.push_back(info);
+            batch.push_back(info);
+        }
+        pos = newline ? line_end + 1 : end;
+
+        if (batch.size() >= publish_batch)
+            publish(loader, batch);
+    }
+    return pos;
+}
+
+// Decodes a compressed log into loader->data front to back, scanning lines
+// as they come out, and notes where every frame starts. Returns false if the
+// log is damaged; the lines before the damage are kept.
+static bool decode_log(LogLoader* loader, std::vector<StepInfo>& steps, std::vector<StepInfo>& batch, std::vector<LogFrame>& frames) {
+    StreamDecoder decoder;
+    if (!decoder_start(&decoder, loader->compression, loader->file, loader->file_size)) {
+        fprintf(stderr, "Couldn't start decoding %s\n", loader->path.c_str());
+        return false;
+    }
+
+    auto          out    = (char*)loader->data;
+    size_t        pos    = 0;
+    decode_status status = decode_more;
+    while (!loader->stop && status == decode_more) {
+        if (decoder.frame_done)
+            frames.push_back({decoder.in_pos, loader->size});
+        size_t capacity = std::min(scan_chunk, loader->mapped - loader->size);
+        if (capacity == 0) {
+            fprintf(stderr, "%s decodes to more than %zu GB, ignoring the rest\n", loader->path.c_str(), loader->mapped >> 30);
+            status = decode_failed;
+            break;
+        }
+        size_t written;
+        status             = decoder_read(&decoder, out + loader->size, capacity, &written);
+        loader->size      += written;
+        loader->bytes_read = (long)decoder.in_pos;
+        pos                = scan_lines(loader, pos, loader->size, status != decode_more, steps, batch);
+    }
+    decoder_stop(&decoder);
+
+    if (status == decode_failed)
+        fprintf(stderr, "%s is damaged after %zu decoded bytes, ignoring the rest\n", loader->path.c_str(), loader->size);
+    return status == decode_end;
+}
+
+// Makes sure the frames holding [offset, offset + length) of a log that is
+// decoded on demand are in loader->data. Pool threads may ask at once.
+static bool decode_span(LogLoader* loader, uint64_t offset, uint64_t length) {
+    const auto& frames = loader->frames;
+    auto        next   = std::upper_bound(frames.begin(), frames.end(), offset, [](uint64_t at, const LogFrame& f) { return at < f.decoded; });
+    for (size_t f = next - frames.begin() - 1; f < frames.size() && frames[f].decoded < offset + length; f++) {
+        if (loader->frame_decoded[f])
+            continue;
+        std::lock_guard lock(loader->decode_mutex);
+        if (loader->frame_decoded[f])
+            continue;
+        uint64_t in_end  = f + 1 < frames.size() ? frames[f + 1].offset : loader->file_size;
+        uint64_t out_end = f + 1 < frames.size() ? frames[f + 1].decoded : loader->size;
+        if (!decode_frame(loader->compression, loader->file + frames[f].offset, in_end - frames[f].offset,
+                          (char*)loader->data + frames[f].decoded, out_end - frames[f].decoded))
+            return false;
+        loader->frame_decoded[f] = true;
+    }
+    return true;
+}
+
+// Cuts steps [first, last) into runs of roughly equal bytes, a few per pool
+// thread so uneven lines still balance. Returns the boundaries: run i is
+// [result[i], result[i + 1]).
+static std::vector<int> split_steps(LogLoader* loader, const std::vector<StepInfo>& steps, int first, int last) {
+    if (first >= last)
+        return {first};
+    uint64_t bytes = steps[last - 1].offset + steps[last - 1].length - steps[first].offset;
+    uint64_t chunk = std::max<uint64_t>(bytes / (pool_width(&loader->pool) * 4), 1);
+
+    std::vector<int> bounds = {first};
+    uint64_t         taken  = 0;
+    for (int s = first; s < last; s++) {
+        taken += steps[s].length;
+        if (taken >= chunk && s + 1 < last) {
+            bounds.push_back(s + 1);
+            taken = 0;
+        }
+    }
+    bounds.push_back(last);
+    return bounds;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Snapshot logs already list their steps, so there is nothing to scan
+static void index_snapshot(LogLoader* loader, std::vector<StepInfo>& steps) {
+    for (uint64_t s = 0; s < loader->snapshot.step_count && !loader->stop; s++) {
+        StepInfo info;
+        if (!snapshot_step_span(&loader->snapshot, s, &info.offset, &info.length) ||
+            !snapshot_step_summary(&loader->snapshot, info.offset, &info.node_count, info.root_bounds)) {
+            fprintf(stderr, "Step %lu of %s is damaged, ignoring the rest\n", (unsigned long)s, loader->path.c_str());
+            break;
+        }
+        steps.push_back(info);
+    }
+}
+
+// Waits for the instrumented app to append to the log and publishes every
+// complete line from `pos` on. There are only ever a few new lines at a time,
+// so they are summarized right away.
+static void follow_log(LogLoader* loader, size_t pos) {
+    int watch = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch >= 0 && inotify_add_watch(watch, loader->path.c_str(), IN_MODIFY) < 0) {
+        close(watch);
+        watch = -1;
+    }
+    if (watch < 0)
+        fprintf(stderr, "Couldn't watch %s (%s), checking it every %d ms\n", loader->path.c_str(), strerror(errno), follow_poll_ms);
+
+    loader->following = true;
+    std::vector<StepInfo> batch;
+    while (!loader->stop) {
+        if (watch >= 0) {
+            pollfd ready = {watch, POLLIN, 0};
+            if (poll(&ready, 1, follow_poll_ms) > 0) {
+                char events[4096];
+                while (read(watch, events, sizeof(events)) > 0) {
+                }
+            }
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(follow_poll_ms));
+        }
+
+        struct stat st;
+        if (fstat(loader->fd, &st) != 0)
+            break;
+        if ((size_t)st.st_size < loader->size) {
+            fprintf(stderr, "%s was truncated, no longer following it\n", loader->path.c_str());
+            break;
+        }
+        if ((size_t)st.st_size > loader->file_mapped) {
+            fprintf(stderr, "%s outgrew the space mapped for it, no longer following it\n", loader->path.c_str());
+            break;
+        }
+        loader->file_size   = st.st_size;
+        loader->size        = st.st_size;
+        loader->bytes_total = (long)st.st_size;
+
+        // A line without its newline yet is still being written
+        while (pos < loader->size) {
+            auto newline = (const char*)memchr(loader->data + pos, '\n', loader->size - pos);
+            if (!newline)
+                break;
+            size_t end = newline - loader->data;
+            if (end > pos) {
+                StepInfo info;
+                info.offset = pos;
+                info.length = end - pos;
+                summarize_step(loader->data, &info);
+                batch.push_back(info);
+            }
+            pos = end + 1;
+        }
+        loader->bytes_read = (long)pos;
+        publish(loader, batch);
+    }
+
+    loader->following = false;
+    if (watch >= 0)
+        close(watch);
+}
+
+static bool seekable(const std::vector<LogFrame>& frames, uint64_t decoded_size) {
+    for (size_t f = 0; f < frames.size(); f++) {
+        uint64_t end = f + 1 < frames.size() ? frames[f + 1].decoded : decoded_size;
+        if (end - frames[f].decoded > seekable_frame_size)
+            return false;
+    }
+    return !frames.empty();
+}
+
+static void index_log(LogLoader* loader) {
+    auto                  start = std::chrono::steady_clock::now();
+    std::vector<StepInfo> steps;
+    std::vector<LogFrame> frames;
+    uint64_t              decoded_size = 0;
+    bool                  known        = false;
+    if (loader->format == snapshot_log) {
+        index_snapshot(loader, steps);
+        known = true;
+    } else if (!loader->follow && load_index(loader, steps, frames, &decoded_size)) {
+        // (A followed log is still growing, so its sidecar is never current)
+        if (loader->compression == compression_none) {
+            known = true;
+        } else if (seekable(frames, decoded_size) && decoded_size <= loader->mapped) {
+            loader->size = decoded_size;
+            loader->frame_decoded.reset(new std::atomic<bool>[frames.size()]());
+            loader->frames = std::move(frames);
+            known          = true;
+        } else {
+            // All of it gets decoded anyway, and summarizing is the cheap part
+            steps.clear();
+            frames.clear();
+        }
+    }
+    if (known) {
+        {
+            std::lock_guard lock(loader->mutex);
+            loader->pending = std::move(steps);
+        }
+        loader->bytes_read   = loader->bytes_total.load();
+        loader->open_seconds = seconds_since(start);
+        loader->indexed      = true;
+        loader->done         = true;
+        return;
+    }
+
+    // First pass: just the newlines, so steps can be viewed right away
+    std::vector<StepInfo> batch;
+    batch.reserve(publish_batch);
+    bool   complete = true;
+    size_t pos      = 0;
+    if (loader->compression != compression_none) {
+        complete = decode_log(loader, steps, batch, frames);
+    } else {
+        for (size_t scanned = 0; !loader->stop && scanned < loader->size;) {
+            scanned = std::min(scanned + scan_chunk, loader->size);
+            // The last line of a followed log may still be being written
+            pos                = scan_lines(loader, pos, scanned, scanned == loader->size && !loader->follow, steps, batch);
+            loader->bytes_read = (long)scanned;
+        }
+    }
+    publish(loader, batch);
+    loader->open_seconds = seconds_since(start);
+    loader->done         = true;
+
+    // Second pass: summaries, then the sidecar so this is the last full scan
+    auto chunks = split_steps(loader, steps, 0, (int)steps.size());
+    pool_for(&loader->pool, (int)chunks.size() - 1, [&](int chunk) {
+        for (int s = chunks[chunk]; s < chunks[chunk + 1] && !loader->stop; s++)
+            summarize_step(loader->data, &steps[s]);
+    });
+    if (loader->stop)
+        return;
+    if (!loader->follow && complete)
+        save_index(loader, steps, frames);
+
+    {
+        std::lock_guard lock(loader->mutex);
+        // Everything still pending is part of the index too
+        loader->pending.clear();
+        loader->pending_index = std::move(steps);
+        if (loader->pending_index.empty())
+            loader->indexed = true;
+    }
+
+    if (loader->follow)
+        follow_log(loader, pos);
+}
+
+bool loader_start(LogLoader* loader, const std::string& path) {
+    loader->path        = path;
+    loader->stop        = false;
+    loader->done        = false;
+    loader->indexed     = false;
+    loader->bytes_read  = 0;
+    loader->bytes_total = 0;
+
+    loader->fd = open(path.c_str(), O_RDONLY);
+    if (loader->fd < 0) {
+        fprintf(stderr, "Couldn't open log: %s (%s)\n", path.c_str(), strerror(errno));
+        loader->done = true;
+        return false;
+    }
+    struct stat st;
+    if (fstat(loader->fd, &st) != 0) {
+        fprintf(stderr, "Couldn't stat log: %s (%s)\n", path.c_str(), strerror(errno));
+        close(loader->fd);
+        loader->fd   = -1;
+        loader->done = true;
+        return false;
+    }
+    if (st.st_size == 0 && !loader->follow) {
+        loader->indexed = true;
+        loader->done    = true;
+        return true;
+    }
+    // Pages past the end of the file become readable once it grows into them
+    size_t length = loader->follow ? std::max<size_t>(st.st_size, grow_reserve) : st.st_size;
+    void*  mapped = mmap(nullptr, length, PROT_READ, loader->follow ? MAP_SHARED : MAP_PRIVATE, loader->fd, 0);
+    if (mapped == MAP_FAILED) {
+        fprintf(stderr, "Couldn't map log: %s (%s)\n", path.c_str(), strerror(errno));
+        close(loader->fd);
+        loader->fd   = -1;
+        loader->done = true;
+        return false;
+    }
+    loader->file        = (const char*)mapped;
+    loader->file_size   = st.st_size;
+    loader->file_mapped = length;
+    loader->data        = loader->file;
+    loader->size        = loader->file_size;
+    loader->mapped      = loader->file_mapped;
+    loader->mtime_ns    = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    loader->bytes_total = (long)st.st_size;
+
+    loader->compression = compression_of(loader->file, loader->file_size);
+    if (loader->compression != compression_none) {
+        if (!compression_supported(loader->compression)) {
+            fprintf(stderr, "Can't read %s compressed logs in this build: %s\n", compression_name(loader->compression), path.c_str());
+            loader->done = true;
+            return false;
+        }
+        if (loader->follow) {
+            fprintf(stderr, "Can't follow a compressed log, opening %s as it is\n", path.c_str());
+            loader->follow = false;
+        }
+        // Only the pages decoded into take up memory
+        void* decoded = mmap(nullptr, grow_reserve, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (decoded == MAP_FAILED) {
+            fprintf(stderr, "Couldn't reserve memory to decode %s (%s)\n", path.c_str(), strerror(errno));
+            loader->done = true;
+            return false;
+        }
+        loader->data   = (const char*)decoded;
+        loader->size   = 0;
+        loader->mapped = grow_reserve;
+    }
+
+    loader->format = json_lines;
+    if (snapshot_is(loader->data, loader->size)) {
+        if (!snapshot_open(&loader->snapshot, loader->data, loader->size)) {
+            fprintf(stderr, "Unsupported or damaged snapshot log: %s\n", path.c_str());
+            loader->done = true;
+            return false;
+        }
+        loader->format = snapshot_log;
+        // A snapshot's step table is written last, so steps can't be appended
+        if (loader->follow) {
+            fprintf(stderr, "Can't follow a snapshot log, opening %s as it is\n", path.c_str());
+            loader->follow = false;
+        }
+    }
+
+    pool_start(&loader->pool);
+    loader->thread = std::thread(index_log, loader);
+    return true;
+}
+
+int loader_drain(LogLoader* loader) {
+    size_t                before = loader->steps.size();
+    std::vector<StepInfo> taken;
+    {
+        std::lock_guard lock(loader->mutex);
+        if (!loader->pending_index.empty()) {
+            // Same steps as the first pass, now with their summaries
+            loader->steps = std::move(loader->pending_index);
+            loader->pending_index.clear();
+            loader->indexed = true;
+        }
+        taken.swap(loader->pending);
+    }
+    loader->steps.insert(loader->steps.end(), taken.begin(), taken.end());
+    return (int)(loader->steps.size() - before);
+}
+
+// Builds the tree of `step` in `arena`, or on the heap when it is null
+static Container* import_step(LogLoader* loader, int step, ContainerArena* arena) {
+    const auto& info = loader->steps[step];
+    if (loader->format == snapshot_log) {
+        auto root = snapshot_import(&loader->snapshot, step, arena);
+        if (!root)
+            fprintf(stderr, "Step %d of %s is damaged\n", step, loader->path.c_str());
+        return root;
+    }
+
+    if (!loader->frames.empty() && !decode_span(loader, info.offset, info.length)) {
+        fprintf(stderr, "Couldn't decode step %d of %s\n", step, loader->path.c_str());
+        return nullptr;
+    }
+    const char* begin = loader->data + info.offset;
+    if (loader->indexed && fnv1a(begin, info.length) != info.hash) {
+        // Rewritten in place with the same size and mtime; don't trust the
+        // sidecar next time
+        fprintf(stderr, "Step %d of %s doesn't match its index, removing %s\n", step, loader->path.c_str(), index_path(loader->path).c_str());
+        unlink(index_path(loader->path).c_str());
+        loader->indexed = false;
+    }
+    try {
+        return import_container(begin, begin + info.length, arena);
+    } catch (const nlohmann::json::exception& e) {
+        // Usually a capture that was cut off mid line
+        fprintf(stderr, "Couldn't import step %d of %s: %s\n", step, loader->path.c_str(), e.what());
+        return nullptr;
+    }
+}
+
+// Releases least recently used trees outside [first, last] until the resident
+// ones fit in the budget
+static void evict(LogLoader* loader, int first, int last) {
+    while (loader->shared.bytes > loader->cache_budget) {
+        auto oldest = loader->resident.end();
+        for (auto it = loader->resident.begin(); it != loader->resident.end(); ++it) {
+            if (it->first >= first && it->first <= last)
+                continue;
+            if (oldest == loader->resident.end() || it->second.last_used < oldest->second.last_used)
+                oldest = it;
+        }
+        if (oldest == loader->resident.end())
+            return;
+        release_tree(&loader->shared, oldest->second.root);
+        loader->resident.erase(oldest);
+    }
+}
+
+Container* loader_step(LogLoader* loader, int step) {
+    if (step < 0 || step >= (int)loader->steps.size())
+        return nullptr;
+
+    int first = std::max(step - loader->neighbours, 0);
+    int last  = std::min(step + loader->neighbours, (int)loader->steps.size() - 1);
+    if (step != loader->viewed) {
+        // Counted once per change of step, not on every call during a frame
+        loader->viewed = step;
+        loader->use_clock++;
+        if (loader->resident.contains(step))
+            loader->cache_hits++;
+        else
+            loader->cache_misses++;
+    }
+
+    std::vector<int> missing;
+    for (int s = first; s <= last; s++) {
+        auto found = loader->resident.find(s);
+        if (found == loader->resident.end())
+            missing.push_back(s);
+        else
+            found->second.last_used = loader->use_clock;
+    }
+    // Most of a fresh tree turns out to be duplicates share_tree throws away,
+    // so trees are built in scratch arenas and the duplicates go all at once.
+    // What is kept lives on the heap (see arena.h).
+    std::vector<Container*>     roots(missing.size());
+    std::vector<ContainerArena> arenas(missing.size());
+    pool_for(&loader->pool, (int)missing.size(), [&](int i) { roots[i] = import_step(loader, missing[i], &arenas[i]); });
+    // Shared in step order, after the parallel part, so the table needs no lock
+    for (size_t i = 0; i < missing.size(); i++) {
+        loader->resident[missing[i]] = {share_tree(&loader->shared, roots[i]), loader->use_clock};
+        arena_release(&arenas[i]);
+    }
+
+    evict(loader, first, last);
+    return loader->resident[step].root;
+}
+
+std::vector<Container*> loader_import(LogLoader* loader, int first, int count) {
+    first    = std::max(first, 0);
+    int last = std::min(first + count, (int)loader->steps.size());
+    if (first >= last)
+        return {};
+
+    std::vector<Container*> roots(last - first);
+    auto                    chunks = split_steps(loader, loader->steps, first, last);
+    pool_for(&loader->pool, (int)chunks.size() - 1, [&](int chunk) {
+        for (int s = chunks[chunk]; s < chunks[chunk + 1]; s++)
+            roots[s - first] = import_step(loader, s, nullptr);
+    });
+    return roots;
+}
+
+void loader_stop(LogLoader* loader) {
+    loader->stop = true;
+    if (loader->thread.joinable())
+        loader->thread.join();
+    pool_stop(&loader->pool);
+
+    for (auto& [step, resident] : loader->resident)
+        release_tree(&loader->shared, resident.root);
+    loader->resident.clear();
+
+    if (loader->data && loader->data != loader->file)
+        munmap((void*)loader->data, loader->mapped);
+    if (loader->file)
+        munmap((void*)loader->file, loader->file_mapped);
+    if (loader->fd >= 0)
+        close(loader->fd);
+    loader->file        = nullptr;
+    loader->file_size   = 0;
+    loader->file_mapped = 0;
+    loader->data        = nullptr;
+    loader->size        = 0;
+    loader->mapped      = 0;
+    loader->fd          = -1;
+    loader->frames.clear();
+    loader->frame_decoded.reset();
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "compression.h"
+#include "pool.h"
+#include "share.h"
+#include "snapshot.h"
+
+struct Container;
+
+// Where one step (one line of the log) lives inside the mapped file, plus a
+// summary of it that is filled in by the index pass. This is also the record
+// stored in the sidecar index, so keep it plain data.
+struct StepInfo {
+    uint64_t offset = 0;
+    uint64_t length = 0;
+
+    // FNV-1a of the line, used to notice a stale index
+    uint64_t hash = 0;
+
+    // 0 until the index pass got to this step
+    uint32_t node_count = 0;
+    uint32_t reserved   = 0;
+
+    // x, y, w and h of the root container
+    double root_bounds[4] = {};
+};
+
+// Where a frame of a compressed log starts, in the file and in the decoded
+// bytes. Stored in the sidecar index too.
+struct LogFrame {
+    uint64_t offset  = 0;
+    uint64_t decoded = 0;
+};
+
+// An imported tree kept around by loader_step
+struct ResidentStep {
+    Container* root = nullptr;
+
+    // loader->use_clock when the step was last viewed or next to the viewed one
+    uint64_t last_used = 0;
+};
+
+enum log_format {
+    // One JSON snapshot per line, as written by the instrumented app
+    json_lines,
+
+    // Binary snapshot log (snapshot.h)
+    snapshot_log,
+};
+
+// Maps a log into memory and indexes it on a background thread so the window
+// can open (and keep painting) while a large capture is still being scanned.
+// For JSON logs the first pass only looks for newlines; a second one
+// summarizes every step and saves the result next to the log (<log>.idx) so
+// opening the same log again is a single read of that file. Snapshot logs
+// carry their own step table. Gzip and zstd compressed JSON logs are decoded
+// into memory as they are scanned; reopening one made of small frames decodes
+// only the frames of the steps looked at. With `follow` set, a JSON log that is still
+// being written keeps being watched after the first scan, and lines appended
+// to it show up as new steps. A step's Container tree is imported when the
+// step is asked for (loader_step), and recently viewed trees are kept around
+// within a memory budget, sharing the subtrees they have in common.
+struct LogLoader {
+    std::string path;
+
+    // Set before loader_start to keep reading lines appended to the log
+    bool follow = false;
+
+    // The mapped log file, read only
+    int         fd          = -1;
+    const char* file        = nullptr;
+    size_t      file_size   = 0;
+    size_t      file_mapped = 0;
+    int64_t     mtime_ns    = 0;
+
+    // What steps point into, shared with the index thread: the file itself,
+    // or the bytes a compressed file decodes to. When following or decoding,
+    // more address space than needed is mapped up front so data never moves
+    // as it grows; size is then only kept up to date for the index thread
+    // (bytes_total is the one to read).
+    const char* data   = nullptr;
+    size_t      size   = 0;
+    size_t      mapped = 0;
+
+    log_compression compression = compression_none;
+
+    // Frames of a compressed log that is decoded on demand, empty when all of
+    // it was decoded up front. Set before any step is published.
+    std::vector<LogFrame>                frames;
+    std::unique_ptr<std::atomic<bool>[]> frame_decoded;
+    std::mutex                           decode_mutex;
+
+    log_format     format = json_lines;
+    SnapshotReader snapshot;
+
+    std::thread thread;
+
+    // Shared by the index pass and step imports
+    ThreadPool pool;
+
+    // Steps found but not yet taken by the UI thread
+    std::mutex            mutex;
+    std::vector<StepInfo> pending;
+
+    // Every step with its summary, handed over once the index pass is done
+    std::vector<StepInfo> pending_index;
+
+    std::atomic<bool> stop = false;
+    std::atomic<bool> done = false;
+
+    // Set once node counts, root bounds and hashes are known for every step
+    std::atomic<bool> indexed = false;
+
+    // True while lines appended to the log are being picked up
+    std::atomic<bool> following = false;
+
+    // Progress, in bytes of the log file
+    std::atomic<long> bytes_read  = 0;
+    std::atomic<long> bytes_total = 0;
+
+    // How long it took until every step was known
+    std::atomic<double> open_seconds = 0;
+
+    // Everything below is only touched by the UI thread
+
+    std::vector<StepInfo> steps;
+
+    // Imported trees by step: the viewed one, its neighbours, and recently
+    // viewed ones while they fit in cache_budget
+    std::map<int, ResidentStep> resident;
+
+    // Owns the nodes of the resident trees, and counts how much of each new
+    // step was already resident
+    SharedTrees shared;
+
+    // How many steps on each side of the viewed one stay imported
+    int neighbours = 1;
+
+    // Bytes the resident trees may take (SharedTrees::bytes) before the least
+    // recently used ones are released. The viewed step and its neighbours
+    // stay regardless.
+    size_t cache_budget = (size_t)256 << 20;
+
+    // Ticks once per loader_step call that changes the viewed step
+    uint64_t use_clock = 0;
+    int      viewed    = -1;
+
+    // Views of a step that found it resident, and ones that had to import it
+    long cache_hits   = 0;
+    long cache_misses = 0;
+};
+
+// Maps `path` and starts indexing it. Returns false if the file couldn't be
+// opened or mapped.
+bool       loader_start(LogLoader* loader, const std::string& path);
+
+// Moves the steps found since the last call (including ones appended to a
+// followed log) into loader->steps and returns how many were added. Never
+// blocks on the index thread.
+int        loader_drain(LogLoader* loader);
+
+// The tree for `step`, imported from the log if it isn't resident yet, along
+// with its neighbours. Least recently viewed trees are released once the
+// cache is over budget, so the pointer is only valid until the next call
+// with a different step. The tree shares
+// nodes with its neighbours (share.h) and must not be modified. Returns
+// nullptr if the step doesn't exist or its line doesn't parse.
+Container* loader_step(LogLoader* loader, int step);
+
+// Imports steps [first, first + count) in parallel, each pool thread taking a
+// run of consecutive lines, and returns the roots in step order (nullptr for
+// lines that don't parse). The caller owns the trees; loader->resident is
+// left alone.
+std::vector<Container*> loader_import(LogLoader* loader, int first, int count);
+
+// Stops the index thread, releases the resident trees and unmaps the log
+void       loader_stop(LogLoader* loader);
@@ -1,6 +1,7 @@
 #include "events.h"
 #include "raylib.h"
 #include <cmath>
+#include <cstdlib>
 #include <event2/event.h>
 #include <exception>
 #include <fstream>
@@ -12,7 +13,9 @@
 
 #include "container.h"
 #include "event.h"
-#include "json.hpp"
+#include "flat.h"
+#include "intern.h"
+#include "loader.h"
 
 std::string font_path_from_name(const std::string& family);
 
@@ -28,13 +31,14 @@ static std::string font = font_path_from_name("SF Pro Rounded");
 #define paint [](Container * root, Container * c)
 #define fz std::format
 
-static std::vector<Container *> roots;
-static std::string clicked_uuid = "";
+static LogLoader loader;
+static uint32_t clicked_uuid = 0; // intern.h id, 0 when nothing is selected
 static int total_steps = 0;
 static int current_step = 0;
 static float zoom_factor = 1.0;
 static float plane_x_off = 0.0;
 static float plane_y_off = 0.0;
+static uint64_t frame_laid_out = 0; // containers the last frame's layout visited
 
 #define BTN_MOUSE		0x110
 #define BTN_LEFT		0x110
@@ -64,22 +68,22 @@ int index_within_parent(Container *parent, Container *c) {
 void add_line(Container *root, Container *c, int depth) {
     auto line = root->child(FILL_SPACE, 36 * dpi);
     line->skip_delete = true;
-    line->user_data = c;
-    line->custom_type = depth;
+    line->cold->user_data = c;
+    line->cold->custom_type = depth;
     line->when_paint = paint {
-        Container *target = (Container *) c->user_data;
+        Container *target = (Container *) c->cold->user_data;
         Rectangle r = {(float) c->real_bounds.x, (float) c->real_bounds.y, (float) c->real_bounds.w, (float) c->real_bounds.h};
-        if (clicked_uuid == target->uuid) {
+        if (clicked_uuid == target->uuid_id) {
             DrawRectangleRec(r, r_bgactive1);
-        } else if (index_within_parent(c->parent, c) % 2 == 0) {
+        } else if (index_within_parent(c->parent, c) % 2 == 1) {
             DrawRectangleRec(r, r_bg2);
         } else {
             DrawRectangleRec(r, r_bg1);
         }
         //DrawRectangleLinesEx(r, std::round(1 * dpi), DARKGRAY);
-        auto text = "Container: " + ((Container *) c->user_data)->uuid;
+        auto text = "Container: " + interned(target->uuid_id);
         Vector2 pos;
-        pos.x = c->real_bounds.x + 30 * dpi + (c->custom_type * (10 * dpi));
+        pos.x = c->real_bounds.x + 30 * dpi + (c->cold->custom_type * (10 * dpi));
         pos.y = c->real_bounds.y + c->real_bounds.h * .5 - (dpi * 18 * .5);
         auto texcolor = BLACK;
         if (!target->exists)
@@ -88,8 +92,8 @@ void add_line(Container *root, Container *c, int depth) {
                  pos,
                  dpi * 18, 2.0, r_text1);
     };
-    line->when_clicked = paint {
-        clicked_uuid = ((Container *) c->user_data)->uuid;
+    line->cold->when_clicked = paint {
+        clicked_uuid = ((Container *) c->cold->user_data)->uuid_id;
     };
     for (auto child : c->children) {
         add_line(root, child, depth + 1);
@@ -106,13 +110,13 @@ void add_data_line(Container *root, int depth, std::string title, std::string co
     auto line_data = new DataLine;
     line_data->title = title;
     line_data->content = content;
-    line->user_data = line_data;
-    line->custom_type = depth;
+    line->cold->user_data = line_data;
+    line->cold->custom_type = depth;
     line->when_paint = paint {
         Rectangle r = {(float) c->real_bounds.x, (float) c->real_bounds.y, (float) c->real_bounds.w, (float) c->real_bounds.h};
-        auto line_data = (DataLine *) c->user_data;
+        auto line_data = (DataLine *) c->cold->user_data;
         Vector2 pos;
-        pos.x = c->real_bounds.x + 10 * dpi + (c->custom_type * (10 * dpi));
+        pos.x = c->real_bounds.x + 10 * dpi + (c->cold->custom_type * (10 * dpi));
         pos.y = c->real_bounds.y + c->real_bounds.h * .5 - (dpi * 18);
         auto texcolor = BLACK;
         
@@ -123,44 +127,21 @@ void add_data_line(Container *root, int depth, std::string title, std::string co
     };
 };
 
-Container *import_container(const nlohmann::json &j) {
-  auto *c = new Container();
-
-  c->uuid = j.value("id", "");
-  c->name = c->uuid;
-
-  c->real_bounds.x = j.value("x", 0);
-  c->real_bounds.y = j.value("y", 0);
-  c->real_bounds.w = j.value("w", 0);
-  c->real_bounds.h = j.value("h", 0);
-
-  c->active = j.value("active", false);
-  c->state.concerned = j.value("concerned", false);
-  c->exists = j.value("exists", false);
-  c->state.mouse_hovering = j.value("mouse_hovering", false);
-  c->state.mouse_pressing = j.value("mouse_pressing", false);
-  c->state.mouse_dragging = j.value("mouse_dragging", false);
-  c->state.mouse_button_pressed = j.value("mouse_button_pressed", 0);
-  c->mouse_current_x = j.value("mouse_current_x", 0);
-  c->mouse_current_y = j.value("mouse_current_y", 0);
-  c->mouse_initial_x = j.value("mouse_initial_x", 0);
-  c->mouse_initial_y = j.value("mouse_initial_y", 0);
-  c->previous_x = j.value("previous_x", 0);
-  c->previous_y = j.value("previous_y", 0);
-
-  c->spacing = j.value("spacing", 0);
-  c->scroll_h_real = j.value("scroll_h_real", 0);
-  c->scroll_v_real = j.value("scroll_v_real", 0);
-
-  // children
-  if (j.contains("children")) {
-    for (const auto &child_json : j["children"]) {
-      Container *child = import_container(child_json);
-      c->children.push_back(child);
-    }
-  }
-
-  return c;
+// The scrolling part of a side panel. Scrolling sets children_offset_y, so
+// the rows keep the bounds they were laid out with and only get drawn (and
+// hit tested) further up.
+Container *scrolled_rows(Container *panel) {
+  auto rows = panel->child(::vbox, FILL_SPACE, USE_CHILD_SIZE);
+  rows->when_paint = paint {
+    Camera2D camera = {};
+    camera.offset = {(float) c->children_offset_x, (float) c->children_offset_y};
+    camera.zoom = 1;
+    BeginMode2D(camera);
+  };
+  rows->after_paint = paint {
+    EndMode2D();
+  };
+  return rows;
 }
 
 // depth=0 → white
@@ -174,37 +155,54 @@ static Color DepthColor(int depth) {
                255};
 }
 
-void paint_active_root(Container *root, Container *c, float zoom, float x_off,
-                       float y_off, int depth) {
-  if (!c)
-    return;
-
-  Color col = DepthColor(depth);
-
-  // Apply zoom + offsets
-  int x = (int)(c->real_bounds.x * zoom + x_off);
-  int y = (int)(c->real_bounds.y * zoom + y_off);
-  int w = (int)(c->real_bounds.w * zoom);
-  int h = (int)(c->real_bounds.h * zoom);
-
-  if (c->uuid == clicked_uuid) {
-      col.r = 1.0;
+// Pre-order is parents before children, the same order the recursive walk
+// painted in
+void paint_active_root(const FlatTree *flat, float zoom, float x_off,
+                       float y_off) {
+  for (auto &node : flat->nodes) {
+    Color col = DepthColor(node.depth);
+
+    // Apply zoom + offsets
+    int x = (int)(node.real_bounds.x * zoom + x_off);
+    int y = (int)(node.real_bounds.y * zoom + y_off);
+    int w = (int)(node.real_bounds.w * zoom);
+    int h = (int)(node.real_bounds.h * zoom);
+
+    if (node.uuid_id == clicked_uuid) {
+        col.r = 1.0;
+    }
+    DrawRectangle(x, y, w, h, r_bgactive1);
+    DrawRectangle(x + 1, y + 1, w - 2, h - 2, col);
   }
-  DrawRectangle(x, y, w, h, r_bgactive1);
-  DrawRectangle(x + 1, y + 1, w - 2, h - 2, col);
+}
 
-  for (auto *child : c->children) {
-    paint_active_root(root, child, zoom, x_off, y_off, depth + 1);
+// Tree of the step being viewed, imported from the log on demand
+Container *current_root() {
+  return loader_step(&loader, current_step);
+}
+
+// Flat copy of current_root(), made again whenever the viewed step changes
+const FlatTree *current_flat() {
+  static FlatTree flat;
+  static int flat_step = -1;
+  static Container *flat_root = nullptr;
+  auto debug_root = current_root();
+  if (flat_step != current_step || flat_root != debug_root) {
+    flat_step = current_step;
+    flat_root = debug_root;
+    flatten_tree(&flat, debug_root);
   }
+  return &flat;
 }
 
 void paint_active_root(Container *root, Container *c) {
-  auto debug_root = roots[current_step];
-  paint_active_root(debug_root, debug_root, zoom_factor, plane_x_off,
-                    plane_y_off, 0);
+  paint_active_root(current_flat(), zoom_factor, plane_x_off, plane_y_off);
 }
 
 void select_container() {
+  auto flat = current_flat();
+  if (flat->nodes.empty())
+    return;
   auto m = GetMousePosition();
 
   // Deproject click 
@@ -213,15 +211,23 @@ void select_container() {
   m.x -= plane_x_off * (1 / zoom_factor);
   m.y -= plane_y_off * (1 / zoom_factor);
 
-  auto p = pierced_containers(roots[current_step], m.x, m.y);
+  auto p = flat_pierced(flat, m.x, m.y);
   if (!p.empty()) {
-      clicked_uuid = p[0]->uuid;
+      clicked_uuid = flat->nodes[p[0]].uuid_id;
   } else {
-      clicked_uuid = "";
+      clicked_uuid = 0;
   }
 }
 
-int main() {
+// Keeps current_step inside the steps loaded so far
+void clamp_step() {
+  if (current_step > total_steps - 1)
+    current_step = total_steps - 1;
+  if (current_step < 0)
+    current_step = 0;
+}
+
+int main(int argc, char *argv[]) {
   const int screenWidth = 1400;
   const int screenHeight = 1200;
 
@@ -237,18 +243,19 @@ int main() {
   static float rightSplit = .6;
   static float rightBottomSplit = .55;
 
-  std::ifstream file("/home/jmanc3/Projects/containerdebug/log.json");
-  std::string line;
-
-  while (std::getline(file, line)) {
-    nlohmann::json ex1 = nlohmann::json::parse(line);
-    Container *root = import_container(ex1);
-    roots.push_back(root);
-
-    // printf("%s\n", ex1.dump(4).c_str());
+  // containerdebug [--follow] [--cache-mb N] [log.json]
+  const char *log_path = "/home/jmanc3/Projects/containerdebug/log.json";
+  for (int i = 1; i < argc; i++) {
+    if (std::string(argv[i]) == "--follow")
+      loader.follow = true;
+    else if (std::string(argv[i]) == "--cache-mb" && i + 1 < argc)
+      loader.cache_budget = (size_t) std::max(atol(argv[++i]), 0L) << 20;
+    else
+      log_path = argv[i];
   }
 
-  total_steps = roots.size();
+  // Steps show up as the loader thread finds them (drained every frame below)
+  loader_start(&loader, log_path);
   current_step = 0;
 
   Container *root = new Container(::hbox, FILL_SPACE, FILL_SPACE);
@@ -271,13 +278,15 @@ int main() {
       paint_active_root(root, c);
     };
     top->after_paint = paint {
-      auto debug_root = roots[current_step];
+      auto debug_root = current_root();
+      if (!debug_root)
+        return;
 
       // Paint cursor
       auto zoom = zoom_factor; 
 
-      int x = (int)(debug_root->mouse_current_x * zoom + plane_x_off);
-      int y = (int)(debug_root->mouse_current_y * zoom + plane_y_off);
+      int x = (int)(debug_root->cold->mouse_current_x * zoom + plane_x_off);
+      int y = (int)(debug_root->cold->mouse_current_y * zoom + plane_y_off);
       int w = (int)(10 * zoom);
       int h = (int)(10 * zoom);
 
@@ -287,7 +296,23 @@ int main() {
     bottom->when_paint = paint {
       DrawRectangle(c->real_bounds.x, c->real_bounds.y, c->real_bounds.w,
                     c->real_bounds.h, DARKGRAY);
-      DrawText(std::to_string(current_step).c_str(), c->real_bounds.x, c->real_bounds.y, 20 * dpi, BLACK);
+      auto text = fz("{} / {}", current_step, total_steps);
+      if (loader.indexed && current_step < total_steps) {
+        const auto &info = loader.steps[current_step];
+        text += fz("  {} nodes  {}x{}", info.node_count, info.root_bounds[2], info.root_bounds[3]);
+      }
+      if (loader.shared.nodes_seen > 0)
+        text += fz("  {} steps resident in {:.1f} MB, {:.0f}% shared, {} hits {} misses", loader.resident.size(),
+                   loader.shared.bytes / 1e6, 100 * share_ratio(&loader.shared), loader.cache_hits, loader.cache_misses);
+      if (!loader.done && loader.bytes_total > 0)
+        text += fz("  (loading {}%)", (int) (100.0 * loader.bytes_read / loader.bytes_total));
+      else if (loader.done)
+        text += fz("  {}{} {:.1f} MB, opened in {:.0f} ms", loader.format == snapshot_log ? "snapshot" : "json",
+                   compression_name(loader.compression), loader.bytes_total / 1e6, loader.open_seconds * 1000);
+      if (loader.following)
+        text += "  following";
+      text += fz("  {} laid out", frame_laid_out);
+      DrawText(text.c_str(), c->real_bounds.x, c->real_bounds.y, 20 * dpi, BLACK);
     };
   }
   Container *right_top = nullptr;
@@ -302,6 +327,8 @@ int main() {
     top->type = ::absolute;
     top->pre_layout = [](Container *root, Container *c, const Bounds &b) {
       static int previous_step = -1;
+      // The rows point into the step's tree, so they go whenever the step
+      // changes, even to one without a tree
       if (previous_step != current_step) {
         previous_step = current_step;
         for (auto c : c->children)
@@ -315,21 +342,21 @@ int main() {
             DrawTextEx(myFont, "Root Tree", pos, dpi * 18, 2.0, r_text1);
         };
         title->z_index = 1;
-        add_line(c, roots[current_step], 0);
+        if (current_root())
+          add_line(scrolled_rows(c), current_root(), 0);
       }
+      // The rows are scrolled with children_offset_y alone, so what layout
+      // offers them doesn't change with the scroll and they are skipped
       auto pre = c->scroll_v_real;
+      auto visual = c->scroll_v_visual;
+      c->scroll_v_visual = 0;
       c->type = ::vbox;
       ::layout(root, c, b);
       c->type = ::absolute;
       c->scroll_v_real = pre;
-      bool first = true;
-      for (auto ch : c->children) {
-          if (first) {
-              first = false;
-              continue;
-          }
-          modify_all(ch, 0, c->scroll_v_real);
-      }
+      c->scroll_v_visual = visual;
+      if (c->children.size() > 1)
+        c->children[1]->children_offset_y = c->scroll_v_real + c->scroll_v_visual;
     };
     top->when_paint = paint {
       BeginScissorMode(c->real_bounds.x, c->real_bounds.y, c->real_bounds.w,
@@ -353,7 +380,9 @@ int main() {
     };
     bottom->type = ::absolute;
     bottom->pre_layout = [](Container *root, Container *c, const Bounds &b) {
-      static std::string previous_focus = "";
+      if (!current_root())
+        return;
+      static uint32_t previous_focus = 0;
       static int previous_step = -1;
       bool forced = false;
       if (previous_step != current_step) {
@@ -364,9 +393,11 @@ int main() {
         previous_focus = clicked_uuid;
         
         //assert(false && "Add the data line by line");
-        Container *b = container_by_name(clicked_uuid, roots[current_step]);
-        if (!b)
+        auto flat = current_flat();
+        uint32_t found = flat_by_uuid_id(flat, clicked_uuid);
+        if (found == flat_none)
             return;
+        const Container *b = flat->nodes[found].source;
         for (auto c : c->children)
             delete c;
         c->children.clear();
@@ -380,60 +411,57 @@ int main() {
         };
         title->z_index = 1;
 
-        add_data_line(c, 0, "UUID", b->uuid);
-        add_data_line(c, 0, "X", fz("{}", b->real_bounds.x));
-        add_data_line(c, 0, "Y", fz("{}", b->real_bounds.y));
-        add_data_line(c, 0, "Width", fz("{}", b->real_bounds.w));
-        add_data_line(c, 0, "Height", fz("{}", b->real_bounds.h));
-        add_data_line(c, 0, "Mouse Hovering", fz("{}", b->state.mouse_hovering));
-        add_data_line(c, 0, "Mouse Pressing", fz("{}", b->state.mouse_pressing));
-        add_data_line(c, 0, "Mouse Button Pressed", fz("{}", b->state.mouse_button_pressed));
-        add_data_line(c, 0, "Mouse Dragging", fz("{}", b->state.mouse_dragging));
-        add_data_line(c, 0, "Mouse X", fz("{}", b->mouse_current_x));
-        add_data_line(c, 0, "Mouse Y", fz("{}", b->mouse_current_y));
-        add_data_line(c, 0, "Mouse Previous X", fz("{}", b->previous_x));
-        add_data_line(c, 0, "Mouse Previous Y", fz("{}", b->previous_y));
+        auto rows = scrolled_rows(c);
+        add_data_line(rows, 0, "UUID", interned(b->uuid_id));
+        add_data_line(rows, 0, "X", fz("{}", b->real_bounds.x));
+        add_data_line(rows, 0, "Y", fz("{}", b->real_bounds.y));
+        add_data_line(rows, 0, "Width", fz("{}", b->real_bounds.w));
+        add_data_line(rows, 0, "Height", fz("{}", b->real_bounds.h));
+        add_data_line(rows, 0, "Mouse Hovering", fz("{}", b->state.mouse_hovering));
+        add_data_line(rows, 0, "Mouse Pressing", fz("{}", b->state.mouse_pressing));
+        add_data_line(rows, 0, "Mouse Button Pressed", fz("{}", b->state.mouse_button_pressed));
+        add_data_line(rows, 0, "Mouse Dragging", fz("{}", b->state.mouse_dragging));
+        add_data_line(rows, 0, "Mouse X", fz("{}", b->cold->mouse_current_x));
+        add_data_line(rows, 0, "Mouse Y", fz("{}", b->cold->mouse_current_y));
+        add_data_line(rows, 0, "Mouse Previous X", fz("{}", b->cold->previous_x));
+        add_data_line(rows, 0, "Mouse Previous Y", fz("{}", b->cold->previous_y));
       }
+      // The rows are scrolled with children_offset_y alone, so what layout
+      // offers them doesn't change with the scroll and they are skipped
       auto pre = c->scroll_v_real;
+      auto visual = c->scroll_v_visual;
+      c->scroll_v_visual = 0;
       c->type = ::vbox;
       ::layout(root, c, b);
       c->type = ::absolute;
       c->scroll_v_real = pre;
-      bool first = true;
-      for (auto ch : c->children) {
-          if (first) {
-              first = false;
-              continue;
-          }
-          modify_all(ch, 0, c->scroll_v_real);
-      }
+      c->scroll_v_visual = visual;
+      if (c->children.size() > 1)
+        c->children[1]->children_offset_y = c->scroll_v_real + c->scroll_v_visual;
     };
     
   }
  
   while (!WindowShouldClose()) {
-    if (IsKeyDown(KEY_RIGHT)) {
-      current_step++;
-      if (current_step > roots.size() - 1)
-          current_step = roots.size() - 1;
+    // While following, sitting on the last step keeps you on the newest one
+    bool at_end = current_step == total_steps - 1;
+    if (loader_drain(&loader) > 0) {
+      total_steps = loader.steps.size();
+      if (loader.following && at_end)
+        current_step = total_steps - 1;
     }
+    if (IsKeyPressed(KEY_END))
+      current_step = total_steps - 1;
 
-    if (IsKeyDown(KEY_LEFT)) {
+    if (IsKeyDown(KEY_RIGHT))
+      current_step++;
+    if (IsKeyDown(KEY_LEFT))
       current_step--;
-      if (current_step < 0)
-          current_step = 0;
-    }
-
-    if (IsKeyPressed(KEY_UP)) {
+    if (IsKeyPressed(KEY_UP))
       current_step++;
-      if (current_step > roots.size() - 1)
-        current_step = roots.size() - 1;
-    }
-    if (IsKeyPressed(KEY_DOWN)) {
+    if (IsKeyPressed(KEY_DOWN))
       current_step--;
-      if (current_step < 0)
-        current_step = 0;
-    }
+    clamp_step();
 
     static bool dragging = false;
     static Vector2 drag_start_mouse;
@@ -455,12 +483,16 @@ int main() {
     if (wheel != 0.0f && bounds_contains(right_top->real_bounds, m.x, m.y)) {
         right_top->scroll_v_visual += wheel * 100;
         right_top->scroll_v_real += wheel * 100;
+        if (right_top->scroll_v_visual > 0)
+           right_top->scroll_v_visual = 0;
         if (right_top->scroll_v_real > 0)
            right_top->scroll_v_real = 0;
     }
     if (wheel != 0.0f && bounds_contains(right_bottom->real_bounds, m.x, m.y)) {
         right_bottom->scroll_v_visual += wheel * 100;
         right_bottom->scroll_v_real += wheel * 100;
+        if (right_bottom->scroll_v_visual > 0)
+           right_bottom->scroll_v_visual = 0;
         if (right_bottom->scroll_v_real > 0)
            right_bottom->scroll_v_real = 0;
      }
@@ -520,14 +552,17 @@ int main() {
     root->wanted_bounds = Bounds(0, 0, sw, sh);
     root->real_bounds = root->wanted_bounds;
 
+    containers_laid_out = 0;
     root->pre_layout(root, root, root->real_bounds);
     ::layout(root, root, root->real_bounds);
+    frame_laid_out = containers_laid_out;
 
     paint_root(root);
 
     EndDrawing();
   }
 
+  loader_stop(&loader);
   CloseWindow();
 
   return 0;
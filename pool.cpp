@@ -0,0 +1,82 @@
+#include "pool.h"
+
+#include <algorithm>
+
+// Runs tasks of `batch` until there are none left to hand out. Called with
+// the lock held; returns with it held.
+static void work_on(ThreadPool* pool, ThreadPool::Batch* batch, std::unique_lock<std::mutex>& lock) {
+    while (batch->next < batch->count) {
+        int task = batch->next++;
+        if (batch->next == batch->count) {
+            // Nothing left to hand out, so workers shouldn't look at it anymore
+            auto it = std::find_if(pool->batches.begin(), pool->batches.end(), [batch](const auto& b) { return b.get() == batch; });
+            if (it != pool->batches.end())
+                pool->batches.erase(it);
+        }
+
+        lock.unlock();
+        batch->fn(task);
+        lock.lock();
+
+        if (++batch->finished == batch->count)
+            pool->batch_finished.notify_all();
+    }
+}
+
+static void worker(ThreadPool* pool) {
+    std::unique_lock lock(pool->mutex);
+    while (true) {
+        pool->work_ready.wait(lock, [pool] { return pool->quit || !pool->batches.empty(); });
+        if (pool->quit)
+            return;
+        // Keep the batch alive while working on it, its caller may be waiting
+        auto batch = pool->batches.front();
+        work_on(pool, batch.get(), lock);
+    }
+}
+
+void pool_start(ThreadPool* pool, int threads) {
+    if (threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    pool->quit = false;
+    // The thread calling pool_for counts as one of them
+    for (int i = 1; i < threads; i++)
+        pool->workers.emplace_back(worker, pool);
+}
+
+void pool_for(ThreadPool* pool, int count, const std::function<void(int)>& fn) {
+    if (count <= 0)
+        return;
+    if (pool->workers.empty() || count == 1) {
+        for (int i = 0; i < count; i++)
+            fn(i);
+        return;
+    }
+
+    auto batch   = std::make_shared<ThreadPool::Batch>();
+    batch->fn    = fn;
+    batch->count = count;
+
+    std::unique_lock lock(pool->mutex);
+    pool->batches.push_back(batch);
+    pool->work_ready.notify_all();
+
+    work_on(pool, batch.get(), lock);
+    // Other threads may still be running tasks they took
+    pool->batch_finished.wait(lock, [&] { return batch->finished == batch->count; });
+}
+
+int pool_width(ThreadPool* pool) {
+    return (int)pool->workers.size() + 1;
+}
+
+void pool_stop(ThreadPool* pool) {
+    {
+        std::lock_guard lock(pool->mutex);
+        pool->quit = true;
+    }
+    pool->work_ready.notify_all();
+    for (auto& thread : pool->workers)
+        thread.join();
+    pool->workers.clear();
+}
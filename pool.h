@@ -0,0 +1,41 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for splitting independent work (log lines,
+// chunks of the file) across cores. Several threads may call pool_for at the
+// same time; each caller also works on its own tasks, so it never waits
+// behind someone else's queue.
+struct ThreadPool {
+    struct Batch {
+        std::function<void(int)> fn;
+        int                      count    = 0;
+        int                      next     = 0; // next task to hand out
+        int                      finished = 0;
+    };
+
+    std::vector<std::thread>           workers;
+    std::mutex                         mutex;
+    std::condition_variable            work_ready;
+    std::condition_variable            batch_finished;
+    std::deque<std::shared_ptr<Batch>> batches;
+    bool                               quit = false;
+};
+
+// Starts `threads` workers, or one per core when 0
+void pool_start(ThreadPool* pool, int threads = 0);
+
+// Calls fn(i) for every i in [0, count) across the pool and returns once all
+// of them are done
+void pool_for(ThreadPool* pool, int count, const std::function<void(int)>& fn);
+
+// Number of threads pool_for can spread work over, including the caller
+int  pool_width(ThreadPool* pool);
+
+void pool_stop(ThreadPool* pool);
@@ -0,0 +1,163 @@
+#include "scan.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86 1
+#endif
+
+// One bit per byte of a 64 byte block
+struct BlockMasks {
+    uint64_t quote     = 0;
+    uint64_t backslash = 0;
+    uint64_t op        = 0; // { } [ ] : ,
+    uint64_t control   = 0; // below 0x20
+    uint64_t space     = 0; // \t \n \r
+    uint64_t high      = 0; // 0x80 and up
+};
+
+[[maybe_unused]] static BlockMasks classify_scalar(const unsigned char* p) {
+    BlockMasks m;
+    for (int i = 0; i < 64; i++) {
+        uint64_t bit = 1ull << i;
+        unsigned char ch = p[i];
+        switch (ch) {
+            case '"': m.quote |= bit; break;
+            case '\\': m.backslash |= bit; break;
+            case '{':
+            case '}':
+            case '[':
+            case ']':
+            case ':':
+            case ',': m.op |= bit; break;
+            case '\t':
+            case '\n':
+            case '\r': m.space |= bit; break;
+        }
+        if (ch < 0x20)
+            m.control |= bit;
+        if (ch >= 0x80)
+            m.high |= bit;
+    }
+    return m;
+}
+
+#ifdef SCAN_X86
+// SSE2 is always there on x86-64, so this is the baseline
+static BlockMasks classify_sse2(const unsigned char* p) {
+    BlockMasks m;
+    for (int i = 0; i < 4; i++) {
+        __m128i v     = _mm_loadu_si128((const __m128i*)(p + 16 * i));
+        auto    match = [&](char ch) { return _mm_cmpeq_epi8(v, _mm_set1_epi8(ch)); };
+        auto    bits  = [&](__m128i x) { return (uint64_t)(uint16_t)_mm_movemask_epi8(x) << (16 * i); };
+
+        // { and [, } and ] only differ in bit 5, so clearing it lets one
+        // compare catch both
+        __m128i folded   = _mm_and_si128(v, _mm_set1_epi8((char)0xdf));
+        __m128i brackets = _mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('[')),
+                                        _mm_cmpeq_epi8(folded, _mm_set1_epi8(']')));
+        __m128i op       = _mm_or_si128(brackets, _mm_or_si128(match(':'), match(',')));
+
+        m.quote |= bits(match('"'));
+        m.backslash |= bits(match('\\'));
+        m.op |= bits(op);
+        m.space |= bits(_mm_or_si128(match('\t'), _mm_or_si128(match('\n'), match('\r'))));
+        m.high |= bits(v);
+        // Signed compare: counts the high bytes as well, they're taken out below
+        m.control |= bits(_mm_cmplt_epi8(v, _mm_set1_epi8(0x20)));
+    }
+    m.control &= ~m.high;
+    return m;
+}
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static uint64_t match_avx2(__m256i v, char ch) {
+    return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(ch)));
+}
+
+AVX2 static BlockMasks classify_avx2(const unsigned char* p) {
+    BlockMasks m;
+    for (int i = 0; i < 2; i++) {
+        __m256i  v      = _mm256_loadu_si256((const __m256i*)(p + 32 * i));
+        __m256i  folded = _mm256_and_si256(v, _mm256_set1_epi8((char)0xdf));
+        int      shift  = 32 * i;
+        uint64_t op = match_avx2(folded, '[') | match_avx2(folded, ']') | match_avx2(v, ':') | match_avx2(v, ',');
+        uint64_t space   = match_avx2(v, '\t') | match_avx2(v, '\n') | match_avx2(v, '\r');
+        uint64_t control = (uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi8(_mm256_set1_epi8(0x20), v));
+
+        m.quote |= match_avx2(v, '"') << shift;
+        m.backslash |= match_avx2(v, '\\') << shift;
+        m.op |= op << shift;
+        m.space |= space << shift;
+        m.high |= (uint64_t)(uint32_t)_mm256_movemask_epi8(v) << shift;
+        m.control |= control << shift;
+    }
+    m.control &= ~m.high;
+    return m;
+}
+#endif
+
+using Classify = BlockMasks (*)(const unsigned char*);
+
+static Classify pick_classify() {
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return classify_avx2;
+    return classify_sse2;
+#else
+    return classify_scalar;
+#endif
+}
+
+// Bit i set if an odd number of bits at or below i are
+static uint64_t prefix_xor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+bool scan_structure(const char* begin, const char* end, std::vector<uint32_t>* structure) {
+    static const Classify classify = pick_classify();
+
+    size_t size = end - begin;
+    if (size >= UINT32_MAX)
+        return false;
+    structure->clear();
+
+    // Set when the previous block ended inside a string
+    uint64_t carry = 0;
+    for (size_t base = 0; base < size; base += 64) {
+        BlockMasks m;
+        if (size - base >= 64) {
+            m = classify((const unsigned char*)begin + base);
+        } else {
+            // The tail, padded with spaces
+            unsigned char block[64];
+            memset(block, ' ', sizeof(block));
+            memcpy(block, begin + base, size - base);
+            m = classify(block);
+        }
+
+        // The opening quote of a string counts as inside, the closing one not
+        uint64_t in_string = prefix_xor(m.quote) ^ carry;
+        carry              = (uint64_t)((int64_t)in_string >> 63);
+
+        uint64_t bad = m.backslash | m.high | (m.control & (in_string | ~m.space));
+        if (bad)
+            return false;
+
+        uint64_t bits = (m.op & ~in_string) | m.quote;
+        while (bits) {
+            structure->push_back((uint32_t)(base + __builtin_ctzll(bits)));
+            bits &= bits - 1;
+        }
+    }
+    return carry == 0;
+}
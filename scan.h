@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Finds the structure of a JSON text in bulk, 64 bytes at a time with SIMD
+// where the CPU has it: the offsets of every { } [ ] : , outside of strings,
+// plus both quotes of every string. Whatever lies between two of them
+// (numbers, true, false, null, whitespace) is left for the caller to read.
+//
+// Only the plain text logs are written in is handled. Returns false, leaving
+// `structure` in an unspecified state, if the text has a backslash, a byte
+// outside ASCII, a control character inside a string or outside whitespace,
+// an unterminated string, or is 4 GB or larger. Callers are expected to fall
+// back to a full JSON parser then.
+bool scan_structure(const char* begin, const char* end, std::vector<uint32_t>* structure);
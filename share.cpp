@@ -0,0 +1,153 @@
+#include "share.h"
+
+#include "container.h"
+
+#include <cstring>
+
+static uint64_t mix(uint64_t hash, uint64_t v) {
+    hash ^= v + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+static uint64_t mix_double(uint64_t hash, double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return mix(hash, bits);
+}
+
+// Covers the fields import_container fills in. Children are already shared,
+// so their addresses stand in for their whole subtrees.
+static uint64_t node_hash(const Container* c) {
+    uint64_t hash = mix(0, c->uuid_id);
+    hash          = mix_double(hash, c->real_bounds.x);
+    hash          = mix_double(hash, c->real_bounds.y);
+    hash          = mix_double(hash, c->real_bounds.w);
+    hash          = mix_double(hash, c->real_bounds.h);
+
+    uint64_t flags = (uint64_t)c->cold->active | (uint64_t)c->state.concerned << 1 | (uint64_t)c->exists << 2 |
+                     (uint64_t)c->state.mouse_hovering << 3 | (uint64_t)c->state.mouse_pressing << 4 |
+                     (uint64_t)c->state.mouse_dragging << 5 | (uint64_t)(uint32_t)c->state.mouse_button_pressed << 8;
+    hash = mix(hash, flags);
+    hash = mix(hash, (uint64_t)(uint32_t)c->cold->mouse_current_x << 32 | (uint32_t)c->cold->mouse_current_y);
+    hash = mix(hash, (uint64_t)(uint32_t)c->cold->mouse_initial_x << 32 | (uint32_t)c->cold->mouse_initial_y);
+    hash = mix(hash, (uint64_t)(uint32_t)c->cold->previous_x << 32 | (uint32_t)c->cold->previous_y);
+    hash = mix_double(hash, c->spacing);
+    hash = mix_double(hash, c->scroll_h_real);
+    hash = mix_double(hash, c->scroll_v_real);
+
+    for (auto child : c->children)
+        hash = mix(hash, (uint64_t)(uintptr_t)child);
+    return mix(hash, c->children.size());
+}
+
+static uint64_t heap_bytes(const std::string& s) {
+    // Short strings live inside the std::string itself
+    return s.capacity() > std::string().capacity() ? s.capacity() + 1 : 0;
+}
+
+static uint64_t node_bytes(const Container* c) {
+    return sizeof(Container) + sizeof(ContainerCold) + heap_bytes(c->cold->name) +
+           c->children.capacity() * sizeof(Container*);
+}
+
+static bool same_node(const Container* a, const Container* b) {
+    return a->uuid_id == b->uuid_id && a->real_bounds.x == b->real_bounds.x &&
+           a->real_bounds.y == b->real_bounds.y && a->real_bounds.w == b->real_bounds.w &&
+           a->real_bounds.h == b->real_bounds.h && a->cold->active == b->cold->active &&
+           a->state.concerned == b->state.concerned && a->exists == b->exists &&
+           a->state.mouse_hovering == b->state.mouse_hovering && a->state.mouse_pressing == b->state.mouse_pressing &&
+           a->state.mouse_dragging == b->state.mouse_dragging &&
+           a->state.mouse_button_pressed == b->state.mouse_button_pressed &&
+           a->cold->mouse_current_x == b->cold->mouse_current_x &&
+           a->cold->mouse_current_y == b->cold->mouse_current_y &&
+           a->cold->mouse_initial_x == b->cold->mouse_initial_x &&
+           a->cold->mouse_initial_y == b->cold->mouse_initial_y && a->cold->previous_x == b->cold->previous_x &&
+           a->cold->previous_y == b->cold->previous_y && a->spacing == b->spacing &&
+           a->scroll_h_real == b->scroll_h_real && a->scroll_v_real == b->scroll_v_real && a->children == b->children;
+}
+
+// Nodes share_tree keeps can't stay in an import arena, which is released
+// once the step is shared. The heap copy takes over the (already shared)
+// children.
+static Container* persist(const Container* node) {
+    auto* c                  = new Container(Container::Imported{});
+    c->uuid_id               = node->uuid_id;
+    c->real_bounds           = node->real_bounds;
+    c->cold->active          = node->cold->active;
+    c->state                 = node->state;
+    c->exists                = node->exists;
+    c->cold->mouse_current_x = node->cold->mouse_current_x;
+    c->cold->mouse_current_y = node->cold->mouse_current_y;
+    c->cold->mouse_initial_x = node->cold->mouse_initial_x;
+    c->cold->mouse_initial_y = node->cold->mouse_initial_y;
+    c->cold->previous_x      = node->cold->previous_x;
+    c->cold->previous_y      = node->cold->previous_y;
+    c->spacing               = node->spacing;
+    c->scroll_h_real         = node->scroll_h_real;
+    c->scroll_v_real         = node->scroll_v_real;
+    c->children.assign(node->children.begin(), node->children.end());
+    return c;
+}
+
+Container* share_tree(SharedTrees* shared, Container* root) {
+    if (!root)
+        return nullptr;
+    // Bottom up, so equal subtrees end up with equal child pointers
+    for (auto& child : root->children)
+        child = share_tree(shared, child);
+
+    shared->nodes_seen++;
+    uint64_t hash      = node_hash(root);
+    auto [first, last] = shared->by_hash.equal_range(hash);
+    for (auto it = first; it != last; ++it) {
+        Container* existing = it->second;
+        if (!same_node(existing, root))
+            continue;
+
+        // `existing` holds its own references to the same children
+        shared->nodes[existing].refs++;
+        shared->nodes_shared++;
+        for (auto child : root->children)
+            release_tree(shared, child);
+        if (!root->arena) {
+            root->children.clear();
+            delete root;
+        }
+        return existing;
+    }
+
+    if (root->arena)
+        root = persist(root);
+    shared->nodes[root] = {hash, 1};
+    shared->by_hash.emplace(hash, root);
+    shared->bytes += node_bytes(root);
+    return root;
+}
+
+void release_tree(SharedTrees* shared, Container* root) {
+    if (!root)
+        return;
+    auto found = shared->nodes.find(root);
+    if (found == shared->nodes.end() || --found->second.refs > 0)
+        return;
+
+    auto [first, last] = shared->by_hash.equal_range(found->second.hash);
+    for (auto it = first; it != last; ++it) {
+        if (it->second == root) {
+            shared->by_hash.erase(it);
+            break;
+        }
+    }
+    shared->nodes.erase(found);
+    shared->bytes -= node_bytes(root);
+
+    for (auto child : root->children)
+        release_tree(shared, child);
+    // The children went through release_tree, so ~Container mustn't see them
+    root->children.clear();
+    delete root;
+}
+
+double share_ratio(const SharedTrees* shared) {
+    return shared->nodes_seen ? (double)shared->nodes_shared / shared->nodes_seen : 0;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+
+struct Container;
+
+// Hash-consed Container trees. Consecutive steps of a log are mostly the same
+// tree, so every imported node is looked up by its fields and its (already
+// shared) children, and an identical node that is already alive is reused
+// instead of keeping a second copy. The steps' roots end up as one DAG.
+//
+// Steps are hash-consed after they are imported rather than while, because
+// the loader imports several at once on its pool and SharedTrees isn't
+// locked. Every node is still parsed in full to be compared, so building
+// the duplicates in an arena first only adds the bump allocations.
+//
+// Shared trees must not be modified or deleted directly, only given back
+// with release_tree. Parent pointers are left unset since a node can have
+// several parents.
+struct SharedTrees {
+    struct Node {
+        uint64_t hash = 0;
+
+        // Parents and roots holding on to the node
+        uint32_t refs = 0;
+    };
+
+    std::unordered_map<const Container*, Node>    nodes;
+    std::unordered_multimap<uint64_t, Container*> by_hash;
+
+    // Roughly what the live nodes take up, strings and child lists included
+    uint64_t bytes = 0;
+
+    // Every node handed to share_tree, and how many of them were already
+    // alive and got reused
+    uint64_t nodes_seen   = 0;
+    uint64_t nodes_shared = 0;
+};
+
+// Takes ownership of the freshly imported tree `root` and returns the shared
+// tree equal to it, deleting the nodes that turned out to be duplicates. The
+// caller holds one reference to the result. A tree built in an arena keeps
+// belonging to it: the nodes worth keeping are copied to the heap, so the
+// arena can be released as soon as this returns.
+Container* share_tree(SharedTrees* shared, Container* root);
+
+// Drops a reference taken by share_tree, deleting the nodes nothing else
+// holds on to
+void       release_tree(SharedTrees* shared, Container* root);
+
+// Fraction of the nodes seen so far that were reused, 0 before any
+double     share_ratio(const SharedTrees* shared);
@@ -0,0 +1,583 @@
+#include "snapshot.h"
+
+#include "arena.h"
+#include "container.h"
+#include "intern.h"
+
+#include <cstring>
+
+// Little-endian encoding, independent of the host
+
+static void put_u8(std::vector<unsigned char>& out, uint8_t v) {
+    out.push_back(v);
+}
+
+static void put_u16(std::vector<unsigned char>& out, uint16_t v) {
+    out.push_back(v & 0xff);
+    out.push_back(v >> 8);
+}
+
+static void put_u32(std::vector<unsigned char>& out, uint32_t v) {
+    for (int i = 0; i < 4; i++)
+        out.push_back((v >> (i * 8)) & 0xff);
+}
+
+static void put_u64(std::vector<unsigned char>& out, uint64_t v) {
+    for (int i = 0; i < 8; i++)
+        out.push_back((v >> (i * 8)) & 0xff);
+}
+
+static void patch_u32(std::vector<unsigned char>& out, size_t at, uint32_t v) {
+    for (int i = 0; i < 4; i++)
+        out[at + i] = (v >> (i * 8)) & 0xff;
+}
+
+static uint16_t get_u16(const unsigned char* p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static uint32_t get_u32(const unsigned char* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t get_u64(const unsigned char* p) {
+    return (uint64_t)get_u32(p) | (uint64_t)get_u32(p + 4) << 32;
+}
+
+static uint32_t f32_bits(double v) {
+    float    f = (float)v;
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+static float bits_f32(uint32_t bits) {
+    float v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+// Word positions inside a node
+enum {
+    word_uuid,
+    word_child_count,
+    word_x,
+    word_y,
+    word_w,
+    word_h,
+    word_flags,
+    word_mouse_current_x,
+    word_mouse_current_y,
+    word_mouse_initial_x,
+    word_mouse_initial_y,
+    word_previous_x,
+    word_previous_y,
+    word_spacing,
+    word_scroll_h_real,
+    word_scroll_v_real,
+};
+
+static std::vector<unsigned char> header_bytes(uint64_t step_count, uint64_t string_table, uint64_t step_table) {
+    std::vector<unsigned char> out(snapshot_magic, snapshot_magic + sizeof(snapshot_magic));
+    put_u32(out, snapshot_version);
+    put_u32(out, 0);
+    put_u64(out, step_count);
+    put_u64(out, string_table);
+    put_u64(out, step_table);
+    return out;
+}
+
+static bool write_bytes(SnapshotWriter* writer, const std::vector<unsigned char>& bytes) {
+    if (fwrite(bytes.data(), 1, bytes.size(), writer->file) != bytes.size())
+        return false;
+    writer->position += bytes.size();
+    return true;
+}
+
+bool snapshot_write_begin(SnapshotWriter* writer, const std::string& path) {
+    writer->file = fopen(path.c_str(), "wb");
+    if (!writer->file)
+        return false;
+    writer->position = 0;
+    writer->string_ids.clear();
+    writer->strings.clear();
+    writer->step_offsets.clear();
+    writer->previous.clear();
+    writer->previous_by_uuid.clear();
+    return write_bytes(writer, header_bytes(0, 0, 0));
+}
+
+static uint32_t string_id(SnapshotWriter* writer, uint32_t uuid_id) {
+    auto [it, added] = writer->string_ids.try_emplace(uuid_id, (uint32_t)writer->strings.size());
+    if (added)
+        writer->strings.push_back(uuid_id);
+    return it->second;
+}
+
+static void append_node(SnapshotWriter* writer, Container* c) {
+    uint32_t flags = 0;
+    if (c->cold->active)
+        flags |= snapshot_flag_active;
+    if (c->state.concerned)
+        flags |= snapshot_flag_concerned;
+    if (c->exists)
+        flags |= snapshot_flag_exists;
+    if (c->state.mouse_hovering)
+        flags |= snapshot_flag_mouse_hovering;
+    if (c->state.mouse_pressing)
+        flags |= snapshot_flag_mouse_pressing;
+    if (c->state.mouse_dragging)
+        flags |= snapshot_flag_mouse_dragging;
+    flags |= ((uint32_t)c->state.mouse_button_pressed & 0xff) << 8;
+
+    uint32_t words[snapshot_node_words] = {
+        string_id(writer, c->uuid_id),
+        (uint32_t)c->children.size(),
+        f32_bits(c->real_bounds.x),
+        f32_bits(c->real_bounds.y),
+        f32_bits(c->real_bounds.w),
+        f32_bits(c->real_bounds.h),
+        flags,
+        (uint32_t)c->cold->mouse_current_x,
+        (uint32_t)c->cold->mouse_current_y,
+        (uint32_t)c->cold->mouse_initial_x,
+        (uint32_t)c->cold->mouse_initial_y,
+        (uint32_t)c->cold->previous_x,
+        (uint32_t)c->cold->previous_y,
+        f32_bits(c->spacing),
+        f32_bits(c->scroll_h_real),
+        f32_bits(c->scroll_v_real),
+    };
+    writer->table.insert(writer->table.end(), words, words + snapshot_node_words);
+
+    for (auto child : c->children)
+        append_node(writer, child);
+}
+
+static void encode_keyframe(SnapshotWriter* writer) {
+    for (auto word : writer->table)
+        put_u32(writer->record, word);
+}
+
+// Ops that turn writer->previous into writer->table
+static void encode_delta(SnapshotWriter* writer) {
+    auto&        out   = writer->record;
+    const auto&  prev  = writer->previous;
+    const auto&  next  = writer->table;
+    size_t       nodes = next.size() / snapshot_node_words;
+
+    // Where the count of the op being extended lives, or 0 if the last op
+    // can't be extended
+    size_t   copy_count_at   = 0;
+    uint32_t copy_next       = 0; // previous index that would extend the copy
+    uint32_t copy_count      = 0;
+    size_t   insert_count_at = 0;
+    uint32_t insert_count    = 0;
+
+    // A previous node is reused at most once, so a delta never holds more
+    // nodes than the previous table plus its inserts (see apply_delta).
+    // Only a uuid repeated within a step makes a difference.
+    std::vector<bool> reused(prev.size() / snapshot_node_words);
+
+    for (size_t i = 0; i < nodes; i++) {
+        const uint32_t* node  = &next[i * snapshot_node_words];
+        auto            found = writer->previous_by_uuid.find(node[word_uuid]);
+        if (found == writer->previous_by_uuid.end() || reused[found->second]) {
+            if (!insert_count_at) {
+                put_u8(out, snapshot_op_insert);
+                insert_count_at = out.size();
+                insert_count    = 0;
+                put_u32(out, 0);
+            }
+            patch_u32(out, insert_count_at, ++insert_count);
+            for (size_t w = 0; w < snapshot_node_words; w++)
+                put_u32(out, node[w]);
+            copy_count_at = 0;
+            continue;
+        }
+        insert_count_at = 0;
+
+        uint32_t        index = found->second;
+        const uint32_t* old   = &prev[index * snapshot_node_words];
+        reused[index]         = true;
+        uint16_t        mask  = 0;
+        for (size_t w = 0; w < snapshot_node_words; w++) {
+            if (node[w] != old[w])
+                mask |= 1 << w;
+        }
+
+        if (mask == 0) {
+            if (copy_count_at && index == copy_next) {
+                patch_u32(out, copy_count_at, ++copy_count);
+            } else {
+                put_u8(out, snapshot_op_copy);
+                put_u32(out, index);
+                copy_count_at = out.size();
+                copy_count    = 1;
+                put_u32(out, 1);
+            }
+            copy_next = index + 1;
+        } else {
+            put_u8(out, snapshot_op_patch);
+            put_u32(out, index);
+            put_u16(out, mask);
+            for (size_t w = 0; w < snapshot_node_words; w++) {
+                if (mask & (1 << w))
+                    put_u32(out, node[w]);
+            }
+            copy_count_at = 0;
+        }
+    }
+}
+
+bool snapshot_write_step(SnapshotWriter* writer, Container* root) {
+    writer->table.clear();
+    if (root)
+        append_node(writer, root);
+    uint32_t node_count = (uint32_t)(writer->table.size() / snapshot_node_words);
+
+    auto& out = writer->record;
+    out.clear();
+    put_u32(out, 0); // record_length, patched below
+    put_u32(out, node_count);
+    put_u32(out, snapshot_keyframe);
+    for (int i = 0; i < 4; i++)
+        put_u32(out, node_count ? writer->table[word_x + i] : 0);
+    size_t header = out.size();
+
+    bool keyframe_due = writer->keyframe_interval <= 1 || writer->previous.empty() ||
+                        writer->step_offsets.size() % writer->keyframe_interval == 0;
+    if (!keyframe_due) {
+        encode_delta(writer);
+        // Wholesale changes are cheaper as a keyframe
+        if (out.size() - header >= writer->table.size() * 4) {
+            out.resize(header);
+            keyframe_due = true;
+        } else {
+            patch_u32(out, 8, snapshot_delta);
+        }
+    }
+    if (keyframe_due)
+        encode_keyframe(writer);
+    patch_u32(out, 0, (uint32_t)(out.size() - 4));
+
+    writer->previous.swap(writer->table);
+    writer->previous_by_uuid.clear();
+    for (uint32_t i = 0; i < node_count; i++)
+        writer->previous_by_uuid.try_emplace(writer->previous[i * snapshot_node_words + word_uuid], i);
+
+    writer->step_offsets.push_back(writer->position);
+    return write_bytes(writer, out);
+}
+
+bool snapshot_write_end(SnapshotWriter* writer) {
+    std::vector<unsigned char> out;
+
+    uint64_t string_table = writer->position;
+    put_u32(out, (uint32_t)writer->strings.size());
+    for (auto uuid_id : writer->strings) {
+        const auto& s = interned(uuid_id);
+        put_u32(out, (uint32_t)s.size());
+        out.insert(out.end(), s.begin(), s.end());
+    }
+
+    uint64_t step_table = string_table + out.size();
+    for (auto offset : writer->step_offsets)
+        put_u64(out, offset);
+
+    bool ok      = write_bytes(writer, out);
+    ok           = ok && fseek(writer->file, 0, SEEK_SET) == 0;
+    ok           = ok && write_bytes(writer, header_bytes(writer->step_offsets.size(), string_table, step_table));
+    ok           = fclose(writer->file) == 0 && ok;
+    writer->file = nullptr;
+    return ok;
+}
+
+bool snapshot_is(const char* data, size_t size) {
+    return size >= snapshot_header_size && memcmp(data, snapshot_magic, sizeof(snapshot_magic)) == 0;
+}
+
+bool snapshot_open(SnapshotReader* reader, const char* data, size_t size) {
+    if (!snapshot_is(data, size))
+        return false;
+    auto     bytes   = (const unsigned char*)data;
+    uint32_t version = get_u32(bytes + 8);
+    if (version < 1 || version > snapshot_version)
+        return false;
+
+    uint64_t step_count   = get_u64(bytes + 16);
+    uint64_t string_table = get_u64(bytes + 24);
+    uint64_t step_table   = get_u64(bytes + 32);
+    if (step_table > size || step_count > (size - step_table) / 8 || string_table > step_table || step_table - string_table < 4)
+        return false;
+
+    reader->strings.clear();
+    const unsigned char* p     = bytes + string_table;
+    const unsigned char* end   = bytes + step_table;
+    uint32_t             count = get_u32(p);
+    p += 4;
+    for (uint32_t i = 0; i < count; i++) {
+        if (end - p < 4)
+            return false;
+        uint32_t length = get_u32(p);
+        p += 4;
+        if ((uint64_t)(end - p) < length)
+            return false;
+        reader->strings.push_back(intern(std::string_view((const char*)p, length)));
+        p += length;
+    }
+
+    reader->data        = bytes;
+    reader->size        = size;
+    reader->version     = version;
+    reader->step_count  = step_count;
+    reader->step_table  = bytes + step_table;
+    reader->cached_step = -1;
+    reader->cached_table.clear();
+    return true;
+}
+
+bool snapshot_step_span(const SnapshotReader* reader, uint64_t step, uint64_t* offset, uint64_t* length) {
+    if (step >= reader->step_count)
+        return false;
+    *offset = get_u64(reader->step_table + step * 8);
+    if (*offset > reader->size || reader->size - *offset < 8)
+        return false;
+    *length = 4 + (uint64_t)get_u32(reader->data + *offset);
+    return *length <= reader->size - *offset;
+}
+
+struct Record {
+    uint32_t             node_count = 0;
+    uint32_t             kind       = snapshot_keyframe;
+    float                root_bounds[4] = {};
+    const unsigned char* payload     = nullptr;
+    const unsigned char* payload_end = nullptr;
+};
+
+// Splits the record at `offset` into its header fields and payload, checking
+// that it fits in the file
+static bool read_record(const SnapshotReader* reader, uint64_t offset, Record* record) {
+    size_t header = reader->version == 1 ? 8 : 28;
+    if (offset > reader->size || reader->size - offset < header)
+        return false;
+    const unsigned char* p      = reader->data + offset;
+    uint64_t             length = get_u32(p);
+    if (length + 4 > reader->size - offset || length + 4 < header)
+        return false;
+
+    record->node_count  = get_u32(p + 4);
+    record->payload     = p + header;
+    record->payload_end = p + 4 + length;
+    if (reader->version == 1) {
+        record->kind = snapshot_keyframe;
+        for (int i = 0; i < 4; i++)
+            record->root_bounds[i] = record->node_count ? bits_f32(get_u32(record->payload + 8 + i * 4)) : 0;
+    } else {
+        record->kind = get_u32(p + 8);
+        for (int i = 0; i < 4; i++)
+            record->root_bounds[i] = bits_f32(get_u32(p + 12 + i * 4));
+    }
+
+    if (record->kind == snapshot_keyframe)
+        return (uint64_t)(record->payload_end - record->payload) == (uint64_t)record->node_count * snapshot_node_size;
+    return record->kind == snapshot_delta;
+}
+
+static bool read_step(const SnapshotReader* reader, uint64_t step, Record* record) {
+    uint64_t offset, length;
+    return snapshot_step_span(reader, step, &offset, &length) && read_record(reader, offset, record);
+}
+
+bool snapshot_step_summary(const SnapshotReader* reader, uint64_t offset, uint32_t* node_count, double root_bounds[4]) {
+    Record record;
+    if (!read_record(reader, offset, &record))
+        return false;
+    *node_count = record.node_count;
+    for (int i = 0; i < 4; i++)
+        root_bounds[i] = record.root_bounds[i];
+    return true;
+}
+
+static void decode_keyframe(const Record& record, SnapshotTable& table) {
+    table.resize((size_t)record.node_count * snapshot_node_words);
+    const unsigned char* p = record.payload;
+    for (auto& word : table) {
+        word = get_u32(p);
+        p += 4;
+    }
+}
+
+// Rebuilds `table` from `prev` with the ops of a delta record
+static bool apply_delta(const SnapshotTable& prev, const Record& record, SnapshotTable& table) {
+    size_t               prev_nodes = prev.size() / snapshot_node_words;
+    const unsigned char* p          = record.payload;
+    const unsigned char* end        = record.payload_end;
+    table.clear();
+    // Every previous node is reused at most once, and the rest come out of
+    // the payload, so a larger count is damage and mustn't size the table
+    if (record.node_count > prev_nodes + (size_t)(end - p) / snapshot_node_size)
+        return false;
+    table.reserve((size_t)record.node_count * snapshot_node_words);
+
+    while (p < end) {
+        if (table.size() > (size_t)record.node_count * snapshot_node_words)
+            return false;
+        uint8_t op = *p++;
+        if (end - p < 4)
+            return false;
+        uint32_t a = get_u32(p);
+        p += 4;
+        if (op == snapshot_op_copy) {
+            if (end - p < 4)
+                return false;
+            uint32_t count = get_u32(p);
+            p += 4;
+            if ((uint64_t)a + count > prev_nodes)
+                return false;
+            table.insert(table.end(), prev.begin() + a * snapshot_node_words, prev.begin() + (a + count) * snapshot_node_words);
+        } else if (op == snapshot_op_patch) {
+            if (a >= prev_nodes || end - p < 2)
+                return false;
+            uint16_t mask = get_u16(p);
+            p += 2;
+            size_t at = table.size();
+            table.insert(table.end(), prev.begin() + a * snapshot_node_words, prev.begin() + (a + 1) * snapshot_node_words);
+            for (size_t w = 0; w < snapshot_node_words; w++) {
+                if (!(mask & (1 << w)))
+                    continue;
+                if (end - p < 4)
+                    return false;
+                table[at + w] = get_u32(p);
+                p += 4;
+            }
+        } else if (op == snapshot_op_insert) {
+            if ((uint64_t)(end - p) < (uint64_t)a * snapshot_node_size)
+                return false;
+            for (size_t w = 0; w < a * snapshot_node_words; w++) {
+                table.push_back(get_u32(p));
+                p += 4;
+            }
+        } else {
+            return false;
+        }
+    }
+    return table.size() == (size_t)record.node_count * snapshot_node_words;
+}
+
+// The node table of `step`, starting from the cached table when it is on the
+// way from the keyframe. Called with reader->cache_mutex held.
+static bool rebuild_table(SnapshotReader* reader, uint64_t step) {
+    // Find the keyframe this step is replayed from
+    uint64_t keyframe = step;
+    Record   record;
+    while (true) {
+        if (!read_step(reader, keyframe, &record))
+            return false;
+        if (record.kind == snapshot_keyframe)
+            break;
+        if (keyframe == 0)
+            return false;
+        keyframe--;
+    }
+
+    uint64_t from;
+    if (reader->cached_step >= (int64_t)keyframe && reader->cached_step <= (int64_t)step) {
+        from = reader->cached_step;
+    } else {
+        decode_keyframe(record, reader->cached_table);
+        from = keyframe;
+    }
+
+    SnapshotTable next;
+    for (uint64_t s = from + 1; s <= step; s++) {
+        if (!read_step(reader, s, &record) || !apply_delta(reader->cached_table, record, next)) {
+            reader->cached_step = -1;
+            return false;
+        }
+        reader->cached_table.swap(next);
+    }
+    reader->cached_step = step;
+    return true;
+}
+
+static Container* read_node(const SnapshotReader* reader, const uint32_t* node, ContainerArena* arena) {
+    if (node[word_uuid] >= reader->strings.size())
+        return nullptr;
+
+    auto* c          = arena_container(arena);
+    c->uuid_id       = reader->strings[node[word_uuid]];
+    c->real_bounds.x = bits_f32(node[word_x]);
+    c->real_bounds.y = bits_f32(node[word_y]);
+    c->real_bounds.w = bits_f32(node[word_w]);
+    c->real_bounds.h = bits_f32(node[word_h]);
+
+    uint32_t flags                = node[word_flags];
+    c->cold->active               = flags & snapshot_flag_active;
+    c->state.concerned            = flags & snapshot_flag_concerned;
+    c->exists                     = flags & snapshot_flag_exists;
+    c->state.mouse_hovering       = flags & snapshot_flag_mouse_hovering;
+    c->state.mouse_pressing       = flags & snapshot_flag_mouse_pressing;
+    c->state.mouse_dragging       = flags & snapshot_flag_mouse_dragging;
+    c->state.mouse_button_pressed = (flags >> 8) & 0xff;
+
+    c->cold->mouse_current_x = (int32_t)node[word_mouse_current_x];
+    c->cold->mouse_current_y = (int32_t)node[word_mouse_current_y];
+    c->cold->mouse_initial_x = (int32_t)node[word_mouse_initial_x];
+    c->cold->mouse_initial_y = (int32_t)node[word_mouse_initial_y];
+    c->cold->previous_x      = (int32_t)node[word_previous_x];
+    c->cold->previous_y      = (int32_t)node[word_previous_y];
+    c->spacing               = bits_f32(node[word_spacing]);
+    c->scroll_h_real         = bits_f32(node[word_scroll_h_real]);
+    c->scroll_v_real         = bits_f32(node[word_scroll_v_real]);
+    return c;
+}
+
+static Container* build_tree(const SnapshotReader* reader, const SnapshotTable& table, ContainerArena* arena) {
+    size_t count = table.size() / snapshot_node_words;
+    if (count == 0)
+        return nullptr;
+
+    // Nodes are in pre-order, so the open parents form a stack, each waiting
+    // for the rest of its children
+    struct Open {
+        Container* container;
+        uint32_t   children_left;
+    };
+    std::vector<Open> open;
+    Container*        root = nullptr;
+    for (size_t i = 0; i < count; i++) {
+        const uint32_t* node = &table[i * snapshot_node_words];
+        Container*      c    = read_node(reader, node, arena);
+        if (!c || (i > 0 && open.empty())) {
+            discard_tree(c);
+            discard_tree(root);
+            return nullptr;
+        }
+        if (i == 0) {
+            root = c;
+        } else {
+            open.back().container->children.push_back(c);
+            if (--open.back().children_left == 0)
+                open.pop_back();
+        }
+        if (uint32_t children = node[word_child_count])
+            open.push_back({c, children});
+    }
+    if (!open.empty()) {
+        discard_tree(root);
+        return nullptr;
+    }
+    return root;
+}
+
+Container* snapshot_import(SnapshotReader* reader, uint64_t step, ContainerArena* arena) {
+    SnapshotTable table;
+    {
+        std::lock_guard lock(reader->cache_mutex);
+        if (!rebuild_table(reader, step))
+            return nullptr;
+        table = reader->cached_table;
+    }
+    return build_tree(reader, table, arena);
+}
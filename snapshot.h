@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct Container;
+struct ContainerArena;
+
+// Binary snapshot log, a compact alternative to log.json holding the same
+// fields import_container reads. Everything is little-endian.
+//
+//   header        magic "CDBGSNAP", u32 version, u32 flags, u64 step_count,
+//                 u64 string_table_offset, u64 step_table_offset
+//   step records  one per step, back to back:
+//                   u32 record_length (bytes after this field)
+//                   u32 node_count
+//                   u32 kind (snapshot_keyframe or snapshot_delta)
+//                   f32 x, y, w, h of the root
+//                   payload
+//   string table  u32 count, then count times u32 length + bytes
+//   step table    step_count times u64 offset of the step's record
+//
+// A node is 16 u32 words: uuid (string table index), child_count, f32 x, y,
+// w, h, a word with the snapshot_flag_* bits in its low byte and
+// mouse_button_pressed in the next, i32 mouse_current_x/y,
+// mouse_initial_x/y, previous_x/y, then f32 spacing, scroll_h_real,
+// scroll_v_real.
+//
+// A keyframe's payload is its nodes in pre-order. Consecutive steps usually
+// differ in a few flags and mouse coordinates, so most steps are instead
+// stored as a delta against the previous step: a list of ops that rebuild
+// the pre-order node table, where nodes of the previous step are found by
+// uuid.
+//
+//   u8 snapshot_op_copy    u32 first, u32 count    nodes copied unchanged
+//   u8 snapshot_op_patch   u32 index, u16 mask,    a node with the words set
+//                          one u32 per set bit     in mask replaced
+//   u8 snapshot_op_insert  u32 count, nodes        nodes the previous step
+//                                                  didn't have
+//
+// Subtrees that went away are simply never copied. A keyframe is written
+// every keyframe_interval steps so reading a step never replays more than
+// that many deltas.
+//
+// Version 1 files (no kind or root bounds, every step a keyframe) can still
+// be read.
+
+static constexpr char     snapshot_magic[8]    = {'C', 'D', 'B', 'G', 'S', 'N', 'A', 'P'};
+static constexpr uint32_t snapshot_version     = 2;
+static constexpr size_t   snapshot_header_size = 40;
+static constexpr size_t   snapshot_node_words  = 16;
+static constexpr size_t   snapshot_node_size   = snapshot_node_words * 4;
+
+enum snapshot_flag {
+    snapshot_flag_active         = 1 << 0,
+    snapshot_flag_concerned      = 1 << 1,
+    snapshot_flag_exists         = 1 << 2,
+    snapshot_flag_mouse_hovering = 1 << 3,
+    snapshot_flag_mouse_pressing = 1 << 4,
+    snapshot_flag_mouse_dragging = 1 << 5,
+};
+
+enum snapshot_record_kind {
+    snapshot_keyframe = 0,
+    snapshot_delta    = 1,
+};
+
+enum snapshot_op {
+    snapshot_op_copy   = 0,
+    snapshot_op_patch  = 1,
+    snapshot_op_insert = 2,
+};
+
+// Pre-order node table of one step, snapshot_node_words words per node in
+// host byte order
+using SnapshotTable = std::vector<uint32_t>;
+
+struct SnapshotWriter {
+    FILE*    file     = nullptr;
+    uint64_t position = 0;
+
+    // Steps between keyframes; 1 makes every step a keyframe
+    int keyframe_interval = 64;
+
+    // String table indices by intern.h id, and the ids in table order
+    std::unordered_map<uint32_t, uint32_t> string_ids;
+    std::vector<uint32_t>                  strings;
+    std::vector<uint64_t>                     step_offsets;
+
+    // The last step written, what the next delta is made against
+    SnapshotTable                          previous;
+    std::unordered_map<uint32_t, uint32_t> previous_by_uuid;
+
+    // Reused between steps
+    SnapshotTable              table;
+    std::vector<unsigned char> record;
+};
+
+// Creates `path` and writes a placeholder header
+bool snapshot_write_begin(SnapshotWriter* writer, const std::string& path);
+
+// Appends one step; steps are numbered in the order they are written
+bool snapshot_write_step(SnapshotWriter* writer, Container* root);
+
+// Writes the string and step tables, fixes up the header and closes the file
+bool snapshot_write_end(SnapshotWriter* writer);
+
+// A snapshot log that lives in memory (usually mapped), read in place
+struct SnapshotReader {
+    const unsigned char* data       = nullptr;
+    size_t                size       = 0;
+    uint32_t              version    = 0;
+    uint64_t              step_count = 0;
+    const unsigned char*  step_table = nullptr;
+    std::vector<uint32_t> strings; // the string table as intern.h ids
+
+    // The last table rebuilt, so stepping forward replays a single delta.
+    // Imports can run on several threads at once.
+    std::mutex    cache_mutex;
+    int64_t       cached_step = -1;
+    SnapshotTable cached_table;
+};
+
+// True if `data` starts like a snapshot log
+bool       snapshot_is(const char* data, size_t size);
+
+// Checks the header and loads the string table. Returns false if the data
+// isn't a snapshot log this version can read.
+bool       snapshot_open(SnapshotReader* reader, const char* data, size_t size);
+
+// Where the record of `step` is, counting its length prefix
+bool       snapshot_step_span(const SnapshotReader* reader, uint64_t step, uint64_t* offset, uint64_t* length);
+
+// Number of nodes and the root's x, y, w, h of the record at `offset`
+bool       snapshot_step_summary(const SnapshotReader* reader, uint64_t offset, uint32_t* node_count, double root_bounds[4]);
+
+// Builds the Container tree of `step`, replaying deltas from the keyframe
+// before it, or nullptr if a record on the way is damaged. The tree is owned
+// by the caller, or by `arena` when one is given.
+Container* snapshot_import(SnapshotReader* reader, uint64_t step, ContainerArena* arena = nullptr);